@@ -0,0 +1,192 @@
+// txcheck-analyze: re-run the isolation oracles over recorded traces (see
+// --record-trace of transfuzz), several traces at a time, without a dbms
+#include "config.h"
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "trace.hh"
+#include "dependency_analyzer.hh"
+
+using namespace std;
+
+struct trace_result {
+    bool analyzed;
+    bool violate;
+    string violated_check;
+    vector<string> allowed_anomalies; // found, but allowed by the checked level
+    string err; // not analyzed: why
+    int stmt_num;
+};
+
+// the files in a directory (sorted), or the file itself
+static void collect_trace_files(string path, vector<string>& files)
+{
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) != 0) {
+        cerr << "cannot access " << path << endl;
+        return;
+    }
+    if (!S_ISDIR(buffer.st_mode)) {
+        files.push_back(path);
+        return;
+    }
+    auto dir = opendir(path.c_str());
+    if (dir == NULL) {
+        cerr << "cannot open " << path << endl;
+        return;
+    }
+    vector<string> dir_files;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        dir_files.push_back(path + "/" + name);
+    }
+    closedir(dir);
+    sort(dir_files.begin(), dir_files.end());
+    for (auto& file : dir_files)
+        collect_trace_files(file, files);
+}
+
+static void analyze_trace(string& path, bool force_level, isolation_level level, ostream* report, trace_result& res)
+{
+    res.analyzed = false;
+    res.violate = false;
+    res.stmt_num = 0;
+    try {
+        txn_trace trace;
+        load_trace(path, trace);
+        res.stmt_num = trace.tid_queue.size();
+        dependency_analyzer da;
+        da.report = report;
+        da.reset(trace.init_output, trace.output_queue, trace.tid_queue, trace.usage_queue,
+                    trace.txn_status_queue, trace.t_num, 1, 0);
+        res.violate = da.check_isolation(force_level ? level : trace.isolation);
+        res.violated_check = da.violated_check;
+        res.allowed_anomalies = da.allowed_anomalies;
+        res.analyzed = true;
+    } catch (exception& e) {
+        res.err = e.what();
+        if (res.err.find("BUG") != string::npos) { // found while building the graphs
+            res.analyzed = true;
+            res.violate = true;
+            res.violated_check = "build";
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    map<string, string> options;
+    vector<string> paths;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            paths.push_back(arg);
+            continue;
+        }
+        auto eq_pos = arg.find('=');
+        if (eq_pos == string::npos)
+            options[arg.substr(2)] = "";
+        else
+            options[arg.substr(2, eq_pos - 2)] = arg.substr(eq_pos + 1);
+    }
+
+    if (options.count("help") || paths.empty()) {
+        cerr << "usage: txcheck-analyze [options] trace_file_or_dir ..." << endl <<
+            "    --threads=int      analyze so many traces at a time (default: hardware concurrency)" << endl <<
+            "    --isolation=level  check this level (PL-2, PL-2.99, PL-SI, PL-3) instead of the recorded one" << endl <<
+            "    --verbose          print the analyzer output (single thread)" << endl <<
+            "    --help             print available command line options and exit" << endl;
+        return 0;
+    }
+
+    int thread_num = thread::hardware_concurrency();
+    if (options.count("threads"))
+        thread_num = stoi(options["threads"]);
+    if (thread_num < 1)
+        thread_num = 1;
+    bool verbose = options.count("verbose");
+    if (verbose)
+        thread_num = 1;
+
+    bool force_level = options.count("isolation");
+    isolation_level level = PL_2;
+    if (force_level) {
+        bool known_level = false;
+        for (int l = PL_2; l <= PL_3; l++) {
+            if (isolation_name((isolation_level)l) != options["isolation"])
+                continue;
+            level = (isolation_level)l;
+            known_level = true;
+        }
+        if (!known_level) {
+            cerr << "unknown isolation level: " << options["isolation"] << endl;
+            return 1;
+        }
+    }
+
+    vector<string> files;
+    for (auto& path : paths)
+        collect_trace_files(path, files);
+    int file_num = files.size();
+    cout << "traces: " << file_num << ", threads: " << thread_num << endl;
+
+    auto begin_time = chrono::steady_clock::now();
+    vector<trace_result> results(file_num);
+    atomic<int> next_file(0);
+    auto worker = [&]() {
+        ostream quiet(NULL); // each thread drops the analyzer output on its own stream
+        while (true) {
+            auto file_idx = next_file++;
+            if (file_idx >= file_num)
+                break;
+            analyze_trace(files[file_idx], force_level, level, verbose ? &cerr : &quiet, results[file_idx]);
+        }
+    };
+    vector<thread> workers;
+    for (int i = 0; i < thread_num - 1; i++)
+        workers.push_back(thread(worker));
+    worker();
+    for (auto& w : workers)
+        w.join();
+    auto cost_ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - begin_time).count();
+
+    int violate_num = 0, error_num = 0;
+    long long total_stmt_num = 0;
+    map<string, int> check_count, allowed_count;
+    for (int i = 0; i < file_num; i++) {
+        auto& res = results[i];
+        total_stmt_num += res.stmt_num;
+        for (auto& anomaly : res.allowed_anomalies)
+            allowed_count[anomaly]++;
+        if (!res.analyzed) {
+            error_num++;
+            cout << "ERROR " << files[i] << ": " << res.err << endl;
+            continue;
+        }
+        if (!res.violate)
+            continue;
+        violate_num++;
+        check_count[res.violated_check]++;
+        cout << "VIOLATE " << files[i] << ": " << res.violated_check << endl;
+    }
+
+    cout << "----------------------------------" << endl;
+    cout << "analyzed: " << file_num - error_num << ", violated: " << violate_num << ", errors: " << error_num << endl;
+    for (auto& count : check_count)
+        cout << "  " << count.first << ": " << count.second << endl;
+    if (!allowed_count.empty())
+        cout << "allowed by the level:" << endl;
+    for (auto& count : allowed_count)
+        cout << "  " << count.first << ": " << count.second << endl;
+    cout << "stmts: " << total_stmt_num << ", time: " << cost_ms << " ms" << endl;
+    return violate_num > 0 ? 2 : 0;
+}
@@ -0,0 +1,373 @@
+// txcheck-bench: time dependency_analyzer on synthetic histories (see make bench),
+// so that the analyzer can be measured without a dbms
+#include "config.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <map>
+#include <functional>
+#include <cstdlib>
+#include <new>
+
+#include "dependency_analyzer.hh"
+
+using namespace std;
+
+// every allocation of the process is counted, the phases report their difference.
+// noinline: gcc warns on free() of the pointer from new once delete is inlined
+static size_t alloc_num = 0;
+static size_t alloc_bytes = 0;
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    alloc_num++;
+    alloc_bytes += size;
+    auto p = malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+        throw bad_alloc();
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+struct bench_option {
+    int history_num;
+    int txn_num;
+    int stmt_num; // read and write stmts per txn, without begin and commit
+    int row_num; // initial rows per table
+    int table_num;
+    int read_pct; // the others are update (1/2), insert (1/4) and delete (1/4)
+    int predicate_pct; // reads and writes on a predicate (with version set read), the others on one key
+    int abort_pct;
+    int anomaly_pct; // reads seeing the uncommitted writes of other txns (G1a, G1b, G1c)
+    unsigned seed;
+};
+
+struct bench_history {
+    vector<stmt_output> init_output;
+    vector<stmt_output> outputs;
+    vector<int> tid_queue;
+    vector<stmt_usage> usage_queue;
+    vector<txn_status> txn_status_queue;
+};
+
+struct row_version {
+    int write_key;
+    int key;
+    int value;
+    bool alive;
+};
+
+// the committed version, and the one written by the txn holding the row lock
+struct bench_row {
+    row_version committed;
+    row_version pending;
+    int owner; // -1: not locked
+};
+
+// execute the txns in a random interleaving on an in-memory database. a txn reads its own
+// writes and the committed versions (read committed), and does not write the rows locked by
+// other txns, except the reads chosen by anomaly_pct, which also see the uncommitted versions
+static void generate_history(bench_option& opt, mt19937& rng, bench_history& h)
+{
+    auto rand_int = [&](int n) { return (int)(rng() % n); };
+    int next_write_key = 1, next_key = 1;
+    vector<vector<bench_row>> db(opt.table_num);
+    h.init_output.assign(opt.table_num, stmt_output());
+    for (int t = 0; t < opt.table_num; t++) {
+        for (int i = 0; i < opt.row_num; i++) {
+            row_version v = {next_write_key++, next_key++, rand_int(10), true};
+            db[t].push_back({v, v, -1});
+            h.init_output[t].push_back({to_string(v.write_key), to_string(v.key), to_string(v.value)});
+        }
+    }
+
+    h.outputs.clear();
+    h.tid_queue.clear();
+    h.usage_queue.clear();
+    h.txn_status_queue.clear();
+    for (int tid = 0; tid < opt.txn_num; tid++)
+        h.txn_status_queue.push_back(rand_int(100) < opt.abort_pct ? TXN_ABORT : TXN_COMMIT);
+
+    auto add_stmt = [&](int tid, stmt_usage su, stmt_output output) {
+        h.tid_queue.push_back(tid);
+        h.usage_queue.push_back(su);
+        h.outputs.push_back(output);
+    };
+    auto row_of = [](row_version& v) {
+        return row_output{to_string(v.write_key), to_string(v.key), to_string(v.value)};
+    };
+    auto visible = [](bench_row& r, int tid, bool dirty) -> row_version& {
+        if (r.owner == tid || (dirty && r.owner != -1))
+            return r.pending;
+        return r.committed;
+    };
+
+    vector<int> left_stmt(opt.txn_num, opt.stmt_num + 2); // with begin and commit
+    vector<vector<pair<int, int>>> locked(opt.txn_num); // (table, row idx)
+    int left_num = opt.txn_num * (opt.stmt_num + 2);
+    while (left_num > 0) {
+        auto tid = rand_int(opt.txn_num);
+        if (left_stmt[tid] == 0)
+            continue;
+        auto step = opt.stmt_num + 2 - left_stmt[tid];
+        left_stmt[tid]--;
+        left_num--;
+
+        if (step == 0) { // begin
+            add_stmt(tid, stmt_usage(INIT_TYPE, false), stmt_output());
+            continue;
+        }
+        if (left_stmt[tid] == 0) { // commit or abort
+            for (auto& pos : locked[tid]) {
+                auto& r = db[pos.first][pos.second];
+                if (h.txn_status_queue[tid] == TXN_COMMIT)
+                    r.committed = r.pending;
+                else
+                    r.pending = r.committed;
+                r.owner = -1;
+            }
+            add_stmt(tid, stmt_usage(INIT_TYPE, false), stmt_output());
+            continue;
+        }
+
+        auto t = rand_int(opt.table_num);
+        auto& table = db[t];
+        auto table_name = "t_" + to_string(t);
+        bool is_predicate = rand_int(100) < opt.predicate_pct;
+        auto target_value = rand_int(3);
+        auto target_key = table.empty() ? 0 : table[rand_int(table.size())].committed.key;
+        auto match = [&](row_version& v) {
+            return v.alive && (is_predicate ? v.value % 3 == target_value : v.key == target_key);
+        };
+        auto version_set_read = [&](bool dirty) {
+            stmt_output output;
+            for (auto& r : table) {
+                auto& v = visible(r, tid, dirty);
+                if (v.alive)
+                    output.push_back(row_of(v));
+            }
+            add_stmt(tid, stmt_usage(VERSION_SET_READ, true, table_name), output);
+        };
+        auto lock_row = [&](int idx) {
+            if (table[idx].owner == tid)
+                return;
+            table[idx].owner = tid;
+            locked[tid].push_back(make_pair(t, idx));
+        };
+
+        auto kind = rand_int(100) < opt.read_pct ? 0 : 1 + rand_int(4);
+        if (kind == 0) { // select
+            bool dirty = rand_int(100) < opt.anomaly_pct;
+            if (is_predicate)
+                version_set_read(dirty);
+            stmt_output output;
+            for (auto& r : table) {
+                auto& v = visible(r, tid, dirty);
+                if (match(v))
+                    output.push_back(row_of(v));
+            }
+            add_stmt(tid, stmt_usage(SELECT_READ, false), output);
+        } else if (kind <= 2) { // update
+            if (is_predicate)
+                version_set_read(false);
+            auto write_key = next_write_key++;
+            stmt_output before, after;
+            for (int i = 0; i < table.size(); i++) {
+                auto& r = table[i];
+                if ((r.owner != -1 && r.owner != tid) || !match(visible(r, tid, false)))
+                    continue;
+                lock_row(i);
+                before.push_back(row_of(r.pending));
+                r.pending.write_key = write_key;
+                r.pending.value = rand_int(10);
+                after.push_back(row_of(r.pending));
+            }
+            add_stmt(tid, stmt_usage(BEFORE_WRITE_READ, true, table_name), before);
+            add_stmt(tid, stmt_usage(UPDATE_WRITE, false, table_name), stmt_output());
+            add_stmt(tid, stmt_usage(AFTER_WRITE_READ, true, table_name), after);
+        } else if (kind == 3) { // delete
+            if (is_predicate)
+                version_set_read(false);
+            stmt_output before;
+            for (int i = 0; i < table.size(); i++) {
+                auto& r = table[i];
+                if ((r.owner != -1 && r.owner != tid) || !match(visible(r, tid, false)))
+                    continue;
+                lock_row(i);
+                before.push_back(row_of(r.pending));
+                r.pending.alive = false;
+            }
+            add_stmt(tid, stmt_usage(BEFORE_WRITE_READ, true, table_name), before);
+            add_stmt(tid, stmt_usage(DELETE_WRITE, false, table_name), stmt_output());
+        } else { // insert
+            row_version v = {next_write_key++, next_key++, rand_int(10), true};
+            row_version dead = v;
+            dead.alive = false;
+            table.push_back({dead, v, -1});
+            lock_row(table.size() - 1);
+            add_stmt(tid, stmt_usage(INSERT_WRITE, false, table_name), stmt_output());
+            add_stmt(tid, stmt_usage(AFTER_WRITE_READ, true, table_name), {row_of(v)});
+        }
+    }
+}
+
+struct phase_stat {
+    double total_us;
+    size_t allocs;
+    size_t bytes;
+    int run_num;
+    int true_num; // the runs returning true (checks)
+};
+
+int main(int argc, char *argv[])
+{
+    map<string, string> options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto eq_pos = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0) {
+            cerr << "cannot parse option: " << arg << endl;
+            options["help"] = "";
+        } else if (eq_pos == string::npos) {
+            options[arg.substr(2)] = "";
+        } else {
+            options[arg.substr(2, eq_pos - 2)] = arg.substr(eq_pos + 1);
+        }
+    }
+    if (options.count("help")) {
+        cerr << "usage: txcheck-bench [options]" << endl <<
+            "    --histories=int      generated histories (default: 50)" << endl <<
+            "    --txns=int           txns per history (default: 10)" << endl <<
+            "    --stmts=int          read and write stmts per txn (default: 10)" << endl <<
+            "    --rows=int           initial rows per table (default: 20)" << endl <<
+            "    --tables=int         tables (default: 2)" << endl <<
+            "    --read-pct=int       percentage of reads among the stmts (default: 50)" << endl <<
+            "    --predicate-pct=int  percentage of predicate stmts, the others access one key (default: 50)" << endl <<
+            "    --abort-pct=int      percentage of aborted txns (default: 20)" << endl <<
+            "    --anomaly-pct=int    percentage of reads seeing uncommitted writes (default: 0)" << endl <<
+            "    --seed=int           random seed (default: 1)" << endl <<
+            "    --verbose            print the analyzer output" << endl <<
+            "    --help               print available command line options and exit" << endl;
+        return 0;
+    }
+
+    auto int_option = [&](string name, int default_value) {
+        return options.count(name) ? stoi(options[name]) : default_value;
+    };
+    bench_option opt;
+    opt.history_num = int_option("histories", 50);
+    opt.txn_num = int_option("txns", 10);
+    opt.stmt_num = int_option("stmts", 10);
+    opt.row_num = int_option("rows", 20);
+    opt.table_num = int_option("tables", 2);
+    opt.read_pct = int_option("read-pct", 50);
+    opt.predicate_pct = int_option("predicate-pct", 50);
+    opt.abort_pct = int_option("abort-pct", 20);
+    opt.anomaly_pct = int_option("anomaly-pct", 0);
+    opt.seed = int_option("seed", 1);
+    if (opt.history_num < 1 || opt.txn_num < 1 || opt.stmt_num < 0 || opt.row_num < 0 || opt.table_num < 1) {
+        cerr << "illegal options, see --help" << endl;
+        return 1;
+    }
+
+    cout << "histories: " << opt.history_num << ", txns: " << opt.txn_num << ", stmts per txn: " << opt.stmt_num
+        << ", rows: " << opt.row_num << ", tables: " << opt.table_num << endl;
+    cout << "read: " << opt.read_pct << "%, predicate: " << opt.predicate_pct << "%, abort: " << opt.abort_pct
+        << "%, anomaly: " << opt.anomaly_pct << "%, seed: " << opt.seed << endl;
+
+    ostream quiet(NULL); // drops the analyzer output
+    auto report = options.count("verbose") ? &cerr : &quiet;
+
+    vector<string> phase_names = {"construct", "check_G1a", "check_G1b", "check_G1c", "check_G1",
+                                    "check_G2_item", "check_GSIa", "check_GSIb",
+                                    "topological_sort_path", "longest_stmt_path"};
+    map<string, phase_stat> stats;
+    for (auto& name : phase_names)
+        stats[name] = phase_stat{0, 0, 0, 0, 0};
+    long long total_stmt_num = 0;
+    int build_violation_num = 0;
+
+    // time f as the phase name, count the runs it returns true
+    auto run_phase = [&](string name, function<bool()> f) {
+        auto& stat = stats[name];
+        auto begin_allocs = alloc_num;
+        auto begin_bytes = alloc_bytes;
+        auto begin_time = chrono::steady_clock::now();
+        auto res = f();
+        stat.total_us += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin_time).count() / 1000.0;
+        stat.allocs += alloc_num - begin_allocs;
+        stat.bytes += alloc_bytes - begin_bytes;
+        stat.run_num++;
+        if (res)
+            stat.true_num++;
+    };
+
+    mt19937 rng(opt.seed);
+    bench_history h;
+    auto bench_begin = chrono::steady_clock::now();
+    for (int i = 0; i < opt.history_num; i++) {
+        generate_history(opt, rng, h);
+        total_stmt_num += h.tid_queue.size();
+
+        shared_ptr<dependency_analyzer> da;
+        try {
+            run_phase("construct", [&]() {
+                da = make_shared<dependency_analyzer>();
+                da->report = report;
+                da->reset(h.init_output, h.outputs, h.tid_queue,
+                            h.usage_queue, h.txn_status_queue, opt.txn_num, 1, 0);
+                return false;
+            });
+        } catch (exception& e) {
+            string err = e.what();
+            if (err.find("BUG") == string::npos) { // not a violation found while building the graphs
+                cerr << "history " << i << ": " << err << endl;
+                return 1;
+            }
+            build_violation_num++;
+            continue;
+        }
+        run_phase("check_G1a", [&]() { return da->check_G1a(); });
+        run_phase("check_G1b", [&]() { return da->check_G1b(); });
+        run_phase("check_G1c", [&]() { return da->check_G1c(); });
+        run_phase("check_G1", [&]() { return da->check_G1(); });
+        run_phase("check_G2_item", [&]() { return da->check_G2_item(); });
+        run_phase("check_GSIa", [&]() { return da->check_GSIa(); });
+        run_phase("check_GSIb", [&]() { return da->check_GSIb(); });
+        run_phase("topological_sort_path", [&]() {
+            set<stmt_id> deleted_nodes;
+            bool delete_flag;
+            da->topological_sort_path(deleted_nodes, &delete_flag);
+            return delete_flag;
+        });
+        run_phase("longest_stmt_path", [&]() { da->longest_stmt_path(); return false; });
+    }
+    long long bench_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - bench_begin).count();
+
+    // true: the check is violated, or topological_sort_path deleted stmts for cycles
+    cout << "----------------------------------" << endl;
+    cout << left << setw(24) << "phase" << right << setw(8) << "runs" << setw(8) << "true"
+        << setw(14) << "avg us" << setw(14) << "allocs/run" << setw(14) << "bytes/run" << endl;
+    for (auto& name : phase_names) {
+        auto& stat = stats[name];
+        auto run_num = max(stat.run_num, 1);
+        cout << left << setw(24) << name << right << setw(8) << stat.run_num << setw(8) << stat.true_num
+            << setw(14) << fixed << setprecision(1) << stat.total_us / run_num
+            << setw(14) << stat.allocs / run_num << setw(14) << stat.bytes / run_num << endl;
+    }
+    cout << "----------------------------------" << endl;
+    auto& construct = stats["construct"];
+    cout << "stmts: " << total_stmt_num << " (" << total_stmt_num / opt.history_num << " per history)"
+        << ", violations found while building: " << build_violation_num << endl;
+    if (construct.total_us > 0)
+        cout << "construct throughput: " << setprecision(0) << total_stmt_num * 1e6 / construct.total_us << " stmts/s" << endl;
+    cout << "total: " << setprecision(1) << bench_us / 1000.0 << " ms (with generation), "
+        << setprecision(1) << opt.history_num * 1e6 / max(bench_us, 1LL) << " histories/s" << endl;
+    return 0;
+}
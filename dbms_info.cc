@@ -1,5 +1,44 @@
 #include "dbms_info.hh"
 
+string isolation_name(isolation_level level)
+{
+    switch (level) {
+    case PL_2: return "PL-2";
+    case PL_2_99: return "PL-2.99";
+    case PL_SI: return "PL-SI";
+    case PL_3: return "PL-3";
+    }
+    return "unknown";
+}
+
+bool get_session_level(string dbms_name, string name, session_level& level)
+{
+    if (dbms_name != "mysql" && dbms_name != "mariadb")
+        return false;
+    level.name = name;
+    // innodb: REPEATABLE READ allows write skew and lost update
+    if (name == "RC") {
+        level.sql_name = "READ COMMITTED";
+        level.guarantee = PL_2;
+    } else if (name == "RR") {
+        level.sql_name = "REPEATABLE READ";
+        level.guarantee = PL_2;
+    } else if (name == "SER") {
+        level.sql_name = "SERIALIZABLE";
+        level.guarantee = PL_3;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void dbms_info::set_session_level(const session_level& level)
+{
+    session_isolation = level.sql_name;
+    session_level_name = level.name;
+    isolation = level.guarantee;
+}
+
 dbms_info::dbms_info(map<string,string>& options)
 {    
     if (false) {}
@@ -9,6 +48,7 @@ dbms_info::dbms_info(map<string,string>& options)
         test_port = 0; // no port
         test_db = options["sqlite"];
         can_trigger_error_in_txn = true;
+        isolation = PL_3;
     }
     #endif 
     #ifdef HAVE_TIDB
@@ -17,6 +57,7 @@ dbms_info::dbms_info(map<string,string>& options)
         test_port = stoi(options["tidb-port"]);
         test_db = options["tidb-db"];
         can_trigger_error_in_txn = true;
+        isolation = PL_SI; // BEGIN OPTIMISTIC
     }
     #endif
     #ifdef HAVE_MYSQL
@@ -25,6 +66,8 @@ dbms_info::dbms_info(map<string,string>& options)
         test_port = stoi(options["mysql-port"]);
         test_db = options["mysql-db"];
         can_trigger_error_in_txn = true;
+        isolation = PL_2; // innodb REPEATABLE READ allows write skew and lost update
+        session_isolation = "REPEATABLE READ";
     }
     #endif
     #ifdef HAVE_MARIADB
@@ -33,6 +76,8 @@ dbms_info::dbms_info(map<string,string>& options)
         test_port = stoi(options["mariadb-port"]);
         test_db = options["mariadb-db"];
         can_trigger_error_in_txn = true;
+        isolation = PL_2; // same as mysql
+        session_isolation = "REPEATABLE READ";
     }
     #endif
     #ifdef HAVE_OCEANBASE
@@ -41,6 +86,7 @@ dbms_info::dbms_info(map<string,string>& options)
         test_port = stoi(options["oceanbase-port"]);
         test_db = options["oceanbase-db"];
         can_trigger_error_in_txn = true;
+        isolation = PL_2;
     }
     #endif 
     #ifdef HAVE_MONETDB
@@ -49,6 +95,7 @@ dbms_info::dbms_info(map<string,string>& options)
         test_port = stoi(options["monetdb-port"]);
         test_db = options["monetdb-db"];
         can_trigger_error_in_txn = false;
+        isolation = PL_SI;
     } 
     #endif
     else if (options.count("cockroach-db") && options.count("cockroach-port")) {
@@ -56,12 +103,14 @@ dbms_info::dbms_info(map<string,string>& options)
         test_port = stoi(options["cockroach-port"]);
         test_db = options["cockroach-db"];
         can_trigger_error_in_txn = false;
+        isolation = PL_3;
     } 
     else if (options.count("postgres-db") && options.count("postgres-port")) {
         dbms_name = "postgres";
         test_port = stoi(options["postgres-port"]);
         test_db = options["postgres-db"];
         can_trigger_error_in_txn = false;
+        isolation = PL_2; // default READ COMMITTED
     }
     else {
         cerr << "Sorry,  you should specify a dbms and its database, or your dbms is not supported" << endl;
@@ -73,5 +122,22 @@ dbms_info::dbms_info(map<string,string>& options)
     else 
         ouput_or_affect_num = 0;
 
+    if (options.count("isolation-levels")) {
+        auto level_list = options["isolation-levels"] + ",";
+        size_t begin = 0, end;
+        while ((end = level_list.find(',', begin)) != string::npos) {
+            auto name = level_list.substr(begin, end - begin);
+            begin = end + 1;
+            if (name.empty())
+                continue;
+            session_level level;
+            if (!get_session_level(dbms_name, name, level)) {
+                cerr << dbms_name << " does not support isolation level " << name << endl;
+                throw runtime_error("Unsupported isolation level");
+            }
+            oracle_levels.push_back(level);
+        }
+    }
+
     return;
 }
\ No newline at end of file
@@ -5,15 +5,37 @@
 #include <string>
 #include <map>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
+// isolation levels in Adya's terms, they decide which anomalies are checked
+// PL_2: G1a, G1b, G1c; PL_2_99: PL_2 + G2-item; PL_SI: PL_2 + G-SIa, G-SIb;
+// PL_3: PL_2 + G2, checked as G2-item because the predicate edges (VS, OW) over-approximate.
+// all of them are checked, the ones a level allows are not bugs
+enum isolation_level {PL_2, PL_2_99, PL_SI, PL_3};
+string isolation_name(isolation_level level);
+
+// an isolation level the test sessions can be set to
+struct session_level {
+    string name; // short name in --isolation-levels: RC, RR, SER
+    string sql_name; // SET SESSION TRANSACTION ISOLATION LEVEL <sql_name>
+    isolation_level guarantee; // checked for the executions at this level
+};
+// false: the dbms cannot set its sessions to the level
+bool get_session_level(string dbms_name, string name, session_level& level);
+
 struct dbms_info {
     string dbms_name;
     string test_db;
     int test_port;
     int ouput_or_affect_num;
     bool can_trigger_error_in_txn;
+    isolation_level isolation; // the guarantee the dbms provides for the test sessions
+    string session_isolation; // sql name of the level the test sessions are set to, empty: the dbms default
+    string session_level_name; // short name of session_isolation if it is set by set_session_level(), empty: not set
+    // --isolation-levels: each schedule is also executed and checked at these levels
+    vector<session_level> oracle_levels;
 
     dbms_info(map<string,string>& options);
     dbms_info() {
@@ -22,14 +44,12 @@ struct dbms_info {
         test_port = 0;
         ouput_or_affect_num = 0;
         can_trigger_error_in_txn = false;
+        isolation = PL_2;
     };
-    void operator=(dbms_info& target) {
-        dbms_name = target.dbms_name;
-        test_db = target.test_db;
-        test_port = target.test_port;
-        ouput_or_affect_num = target.ouput_or_affect_num;
-        can_trigger_error_in_txn = target.can_trigger_error_in_txn;
-    }
+    dbms_info(const dbms_info& target) = default;
+    dbms_info& operator=(const dbms_info& target) = default;
+    // the test sessions are set to level, and checked with its guarantee
+    void set_session_level(const session_level& level);
 };
 
 #endif
\ No newline at end of file
@@ -1,83 +1,201 @@
 #include <dependency_analyzer.hh>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <queue>
 
-void history::insert_to_history(operate_unit& oper_unit)
+void stmt_graph::reset(int n, bool is_sparse)
 {
-    auto row_id = oper_unit.row_id;
-    auto size = change_history.size();
-    bool exist_row_id = false;
-    int row_idx;
-    for (int i = 0; i < size; i ++) {
-        if (change_history[i].row_id == row_id) {
-            exist_row_id = true;
-            row_idx = i;
-            break;
+    node_num = n;
+    sparse = is_sparse;
+    for (auto& list : out_list)
+        list.clear();
+    for (auto& list : in_list)
+        list.clear();
+    out_list.resize(n);
+    in_list.resize(n);
+    if (!sparse) {
+        adj.assign((size_t)n * n, 0);
+        sparse_rows.clear();
+        return;
+    }
+    adj.clear();
+    for (auto& row : sparse_rows)
+        row.clear();
+    sparse_rows.resize(n);
+}
+
+void stmt_graph::compact()
+{
+    for (int from = 0; from < node_num; from++) {
+        out_list[from].clear();
+        in_list[from].clear();
+    }
+    if (!sparse) {
+        for (int from = 0; from < node_num; from++) {
+            auto row = &adj[(size_t)from * node_num];
+            for (int to = 0; to < node_num; to++) {
+                if (row[to] != 0)
+                    out_list[from].push_back(to);
+            }
+        }
+    } else {
+        for (int from = 0; from < node_num; from++) {
+            auto& row = sparse_rows[from];
+            sort(row.begin(), row.end());
+            int merged = 0;
+            for (int i = 0; i < row.size(); i++) {
+                if (merged > 0 && row[merged - 1].first == row[i].first)
+                    row[merged - 1].second |= row[i].second;
+                else
+                    row[merged++] = row[i];
+            }
+            row.resize(merged);
+            for (auto& edge : row)
+                out_list[from].push_back(edge.first);
         }
     }
-
-    if (exist_row_id) 
-        change_history[row_idx].row_op_list.push_back(oper_unit);
-    else {
-        row_change_history rch;
-        rch.row_id = row_id;
-        rch.row_op_list.push_back(oper_unit);
-        change_history.push_back(rch);
+    for (int from = 0; from < node_num; from++) {
+        for (auto to : out_list[from])
+            in_list[to].push_back(from);
     }
+}
 
-    return;
+// remove node from a sorted neighbour list
+static void erase_neighbour(vector<int>& list, int node)
+{
+    auto it = lower_bound(list.begin(), list.end(), node);
+    if (it != list.end() && *it == node)
+        list.erase(it);
 }
 
-stmt_id::stmt_id(vector<int>& final_tid_queue, int stmt_idx)
+// drop the zero edges of a sparse row
+static void erase_zero_edges(vector<pair<int, depend_mask>>& row)
 {
-    txn_id = final_tid_queue[stmt_idx];
-    stmt_idx_in_txn = -1;
-    for (int i = 0; i <= stmt_idx; i++) {
-        if (final_tid_queue[i] == txn_id)
-            stmt_idx_in_txn++;
+    int kept = 0;
+    for (int i = 0; i < row.size(); i++) {
+        if (row[i].second != 0)
+            row[kept++] = row[i];
     }
+    row.resize(kept);
 }
 
-// -1: error, txn_id or stmt_idx_in_txn is -1, or cannot find 
-int stmt_id::transfer_2_stmt_idx(vector<int>& final_tid_queue)
+void stmt_graph::remove_types(depend_mask mask)
 {
-    if (txn_id == -1 || stmt_idx_in_txn == -1)
-        return -1;
-    int tmp_target_txn_idx = -1;
-    auto queue_size = final_tid_queue.size();
-    for (int i = 0; i < queue_size; i++) {
-        if (final_tid_queue[i] != txn_id)
+    if (!sparse) {
+        for (auto& edge : adj)
+            edge &= ~mask;
+    } else {
+        for (auto& row : sparse_rows) {
+            for (auto& edge : row)
+                edge.second &= ~mask;
+            erase_zero_edges(row);
+        }
+    }
+    for (int from = 0; from < node_num; from++) {
+        auto& list = out_list[from];
+        int kept = 0;
+        for (int i = 0; i < list.size(); i++) {
+            if (get(from, list[i]) != 0)
+                list[kept++] = list[i];
+        }
+        list.resize(kept);
+        in_list[from].clear();
+    }
+    for (int from = 0; from < node_num; from++) {
+        for (auto to : out_list[from])
+            in_list[to].push_back(from);
+    }
+}
+
+void stmt_graph::delete_node(int node)
+{
+    for (auto to : out_list[node]) {
+        if (!sparse)
+            adj[(size_t)node * node_num + to] = 0;
+        if (to != node)
+            erase_neighbour(in_list[to], node);
+    }
+    for (auto from : in_list[node]) {
+        if (from == node)
             continue;
-        tmp_target_txn_idx++;
-        if (tmp_target_txn_idx == stmt_idx_in_txn)
-            return i;
+        if (!sparse) {
+            adj[(size_t)from * node_num + node] = 0;
+        } else {
+            auto& row = sparse_rows[from];
+            auto it = lower_bound(row.begin(), row.end(), make_pair(node, (depend_mask)0));
+            if (it != row.end() && it->first == node)
+                row.erase(it);
+        }
+        erase_neighbour(out_list[from], node);
     }
-    return -1;
+    if (sparse)
+        sparse_rows[node].clear();
+    out_list[node].clear();
+    in_list[node].clear();
 }
 
-void dependency_analyzer::build_stmt_depend_from_stmt_idx(int stmt_idx1, int stmt_idx2, dependency_type dt)
+void stmt_graph::out_neighbours(int node, vector<int>& res) const
+{
+    res = out_list[node];
+}
+
+void stmt_graph::out_edges(int node, vector<pair<int, depend_mask>>& res) const
 {
-    auto stmt_id1 = stmt_id(f_txn_id_queue, stmt_idx1);
-    auto stmt_id2 = stmt_id(f_txn_id_queue, stmt_idx2);
-    auto stmt_pair = make_pair(stmt_id1, stmt_id2);
-    if (stmt_dependency_graph.count(stmt_pair) > 0)
-        stmt_dependency_graph[stmt_pair].insert(dt);
-    else {
-        set<dependency_type> d_set;
-        d_set.insert(dt);
-        stmt_dependency_graph[stmt_pair] = d_set;
+    if (sparse) {
+        res = sparse_rows[node];
+        return;
     }
+    res.clear();
+    for (auto to : out_list[node])
+        res.push_back(make_pair(to, adj[(size_t)node * node_num + to]));
 }
 
-size_t dependency_analyzer::hash_output(row_output& row)
+void stmt_graph::in_neighbours(int node, vector<int>& res) const
 {
-    register size_t hash = 0; 
-    for (auto& str:row) {
-        auto size = str.size();
-        for (int i = 0; i < size; i++ ) {
-            size_t ch = (size_t)str[i];
-            hash = hash * 131 + ch;
-        }
+    res = in_list[node];
+}
+
+bool stmt_graph::has_in_edge(int node) const
+{
+    return !in_list[node].empty();
+}
+
+stmt_output_ref empty_stmt_output()
+{
+    static stmt_output_ref empty_output = make_shared<const stmt_output>();
+    return empty_output;
+}
+
+int history::insert_to_history(operate_unit& oper_unit)
+{
+    auto row_id = oper_unit.row_id;
+    auto ret = row_id_to_idx.insert(make_pair(row_id, (int)change_history.size()));
+    auto row_idx = ret.first->second;
+    if (ret.second) { // new row
+        row_change_history rch;
+        rch.row_id = row_id;
+        change_history.push_back(rch);
     }
-    return hash;
+    change_history[row_idx].row_op_list.push_back(oper_unit);
+
+    return row_idx;
+}
+
+// -1: error, txn_id or stmt_idx_in_txn is -1, or cannot find 
+int dependency_analyzer::get_queue_idx(const stmt_id& sid)
+{
+    if (sid.txn_id < 0 || sid.txn_id >= tid_num || sid.stmt_idx_in_txn < 0)
+        return -1;
+    auto& txn_queue_idx = txn_stmt_queue_idx[sid.txn_id];
+    if (sid.stmt_idx_in_txn >= txn_queue_idx.size())
+        return -1;
+    return txn_queue_idx[sid.stmt_idx_in_txn];
+}
+
+void dependency_analyzer::build_stmt_depend_from_stmt_idx(int stmt_idx1, int stmt_idx2, dependency_type dt)
+{
+    stmt_dependency_graph.add_edge(stmt_idx1, stmt_idx2, dt);
 }
 
 // for BEFORE_WRITE_READ, VERSION_SET_READ, SELECT_READ
@@ -90,7 +208,7 @@ void dependency_analyzer::build_WR_dependency(vector<operate_unit>& op_list, int
             continue;
         
         // need strict compare to check whether the write is missed
-        if (op_list[i].hash != target_op.hash)
+        if (op_list[i].row_ref != target_op.row_ref)
             continue;
         
         find_the_write = true;
@@ -98,29 +216,38 @@ void dependency_analyzer::build_WR_dependency(vector<operate_unit>& op_list, int
         if (op_list[i].stmt_idx >= 0 && target_op.stmt_idx >= 0) // stmts in same transaction should build dependency 
             build_stmt_depend_from_stmt_idx(op_list[i].stmt_idx, target_op.stmt_idx, WRITE_READ);
 
-        if (op_list[i].tid != target_op.tid) 
-            dependency_graph[op_list[i].tid][target_op.tid].insert(WRITE_READ);
+        if (op_list[i].tid != target_op.tid) {
+            dependency_graph.add_edge(op_list[i].tid, target_op.tid, WRITE_READ);
+            // G1a: an aborted version read by a committed txn
+            auto abort_tid = op_list[i].tid;
+            auto commit_tid = target_op.tid;
+            if (f_txn_status[abort_tid] == TXN_ABORT && f_txn_status[commit_tid] == TXN_COMMIT &&
+                    (g1a_abort_tid == -1 || make_pair(abort_tid, commit_tid) < make_pair(g1a_abort_tid, g1a_commit_tid))) {
+                g1a_abort_tid = abort_tid;
+                g1a_commit_tid = commit_tid;
+            }
+        }
         
         break; // only find the nearest write
     }
     if (find_the_write == false) {
-        cerr << "Read stmt idx: " << target_op.stmt_idx << endl;
-        cerr << "Read stmt tid: " << target_op.tid << endl;
+        *report << "Read stmt idx: " << target_op.stmt_idx << endl;
+        *report << "Read stmt tid: " << target_op.tid << endl;
         
-        cerr << "Problem read: ";
-        auto& problem_row = hash_to_output[target_op.hash];
+        *report << "Problem read: ";
+        auto& problem_row = rows.get(target_op.row_ref);
         for (int i = 0; i < problem_row.size(); i++)
-            cerr << problem_row[i] << " ";
-        cerr << endl;
+            *report << problem_row[i] << " ";
+        *report << endl;
 
         for (int i = 0; i < op_list.size(); i++) {
             if (op_list[i].stmt_u != AFTER_WRITE_READ)
                 continue;
-            cerr << "AFTER_WRITE_READ " << i << ": ";
-            auto& write_row = hash_to_output[op_list[i].hash];
+            *report << "AFTER_WRITE_READ " << i << ": ";
+            auto& write_row = rows.get(op_list[i].row_ref);
             for (int i = 0; i < write_row.size(); i++)
-                cerr << write_row[i] << " ";
-            cerr << endl;
+                *report << write_row[i] << " ";
+            *report << endl;
         }
 
         throw runtime_error("BUG: Cannot find the corresponding write");
@@ -151,7 +278,7 @@ void dependency_analyzer::build_RW_dependency(vector<operate_unit>& op_list, int
             build_stmt_depend_from_stmt_idx(op_list[i].stmt_idx, target_op.stmt_idx, READ_WRITE);
 
         if (op_list[i].tid != target_op.tid)
-            dependency_graph[op_list[i].tid][target_op.tid].insert(READ_WRITE);
+            dependency_graph.add_edge(op_list[i].tid, target_op.tid, READ_WRITE);
 
         // do not break, because need to find all the read
     }
@@ -172,7 +299,7 @@ void dependency_analyzer::build_WW_dependency(vector<operate_unit>& op_list, int
             continue;
 
         // need strict compare to find miss write bug
-        if (op_list[i].hash != target_op.hash)
+        if (op_list[i].row_ref != target_op.row_ref)
             continue;
         
         find_the_write = true;
@@ -181,7 +308,7 @@ void dependency_analyzer::build_WW_dependency(vector<operate_unit>& op_list, int
                 build_stmt_depend_from_stmt_idx(op_list[i].stmt_idx, target_op.stmt_idx, WRITE_WRITE);
 
         if (op_list[i].tid != target_op.tid) 
-            dependency_graph[op_list[i].tid][target_op.tid].insert(WRITE_WRITE);
+            dependency_graph.add_edge(op_list[i].tid, target_op.tid, WRITE_WRITE);
 
         break; // only find the nearest write
     }
@@ -191,106 +318,104 @@ void dependency_analyzer::build_WW_dependency(vector<operate_unit>& op_list, int
     return;
 }
 
+void dependency_analyzer::get_pv_pairs(int stmt_idx, vector<pair<int, int>>& pv_pairs)
+{
+    pv_pairs.clear();
+    for (auto& row : f_stmt_output[stmt_idx]) {
+        auto row_id = stoi(row[primary_key_index]);
+        auto version_id = stoi(row[version_key_index]);
+        pv_pairs.push_back(make_pair(row_id, version_id));
+    }
+}
+
 // should be used after build_start_dependency
 void dependency_analyzer::build_VS_dependency()
 {
-    // if (tid_begin_idx == NULL || tid_strict_begin_idx == NULL || tid_end_idx == NULL) {
-    //     cerr << "you should not use build_VS_dependency before build_start_dependency" << endl;
-    //     throw runtime_error("you should not use build_VS_dependency before build_start_dependency");
-    // }
+    vector<int> version_set_reads;
     for (int i = 0; i < stmt_num; i++) {
+        if (f_stmt_usage[i] == VERSION_SET_READ)
+            version_set_reads.push_back(i);
+    }
+    if (version_set_reads.empty())
+        return;
+
+    // (primary_key, version_key) -> AFTER_WRITE_READ of the update/insert that writes the version
+    map<pair<int, int>, vector<int>> written_version_index;
+    // target_table -> delete (whose BEFORE_WRITE_READ is not empty)
+    map<string, vector<int>> table_delete_index;
+    bool has_delete = false;
+    vector<pair<int, int>> pv_pairs;
+    for (int j = 0; j < stmt_num; j++) {
+        auto& j_stmt_u = f_stmt_usage[j];
+        if (j_stmt_u == UPDATE_WRITE || j_stmt_u == INSERT_WRITE) {
+            auto after_write_idx = j + 1;
+            if (after_write_idx >= stmt_num || f_stmt_usage[after_write_idx] != AFTER_WRITE_READ) {
+                auto err_info = "[INSTRUMENT_ERR] build_VS_dependency: after_write_idx is not AFTER_WRITE_READ, after_write_idx = " + to_string(after_write_idx);
+                *report << err_info << endl;
+                throw runtime_error(err_info);
+            }
+            get_pv_pairs(after_write_idx, pv_pairs);
+            for (auto& pv : pv_pairs)
+                written_version_index[pv].push_back(after_write_idx);
+        }
+        else if (j_stmt_u == DELETE_WRITE) {
+            auto before_write_idx = j - 1;
+            if (before_write_idx < 0 || f_stmt_usage[before_write_idx] != BEFORE_WRITE_READ) {
+                auto err_info = "[INSTRUMENT_ERR] build_VS_dependency: before_write_idx is not BEFORE_WRITE_READ, before_write_idx = " + to_string(before_write_idx);
+                *report << err_info << endl;
+                throw runtime_error(err_info);
+            }
+            if (f_stmt_usage[before_write_idx].target_table == "") {
+                auto err_info = "[INSTRUMENT_ERR] build_VS_dependency: target_table is not initialized, before_write_idx = " + to_string(before_write_idx);
+                *report << err_info << endl;
+                throw runtime_error(err_info);
+            }
+            has_delete = true;
+            if (f_stmt_output[before_write_idx].empty()) // delete nothing, skip
+                continue;
+            table_delete_index[f_stmt_usage[before_write_idx].target_table].push_back(j);
+        }
+    }
+
+    vector<int> linked_read(stmt_num, -1); // the last version set read that an edge is built to
+    for (auto i : version_set_reads) {
         auto& i_stmt_u = f_stmt_usage[i];
-        if (i_stmt_u != VERSION_SET_READ)
-            continue;
         auto& i_tid = f_txn_id_queue[i];
-        auto& i_output = f_stmt_output[i];
 
-        set<pair<int, int>> i_pv_pair_set; // primary_key, version_key
-        set<int> i_primary_set; // primary_key
-        for (auto& row : i_output) {
-            auto row_id = stoi(row[primary_key_index]);
-            auto version_id = stoi(row[version_key_index]);
-            pair<int, int> p(row_id, version_id);
-            i_pv_pair_set.insert(p);
-            i_primary_set.insert(row_id);
+        // the changed version is seen in version read
+        // update/insert -> AFTER_WRITE_READ -> VERSION_SET_READ -> target_one
+        get_pv_pairs(i, pv_pairs);
+        for (auto& pv : pv_pairs) {
+            auto version_iter = written_version_index.find(pv);
+            if (version_iter == written_version_index.end())
+                continue;
+            for (auto after_write_idx : version_iter->second) {
+                if (linked_read[after_write_idx] == i)
+                    continue;
+                linked_read[after_write_idx] = i;
+                auto& j_tid = f_txn_id_queue[after_write_idx];
+                if (i_tid != j_tid)
+                    dependency_graph.add_edge(j_tid, i_tid, VERSION_SET_DEPEND);
+                build_stmt_depend_from_stmt_idx(after_write_idx, i, VERSION_SET_DEPEND);
+            }
         }
 
-        for (int j = 0; j < stmt_num; j++) {
+        if (has_delete && i_stmt_u.target_table == "") {
+            auto err_info = "[INSTRUMENT_ERR] build_VS_dependency: target_table is not initialized, version_set_read_idx = " + to_string(i);
+            *report << err_info << endl;
+            throw runtime_error(err_info);
+        }
+        // every delete of the same table, the deleted rows are not matched with 
+        // the read ones (the intersection of them was always empty)
+        // BEFORE_WRITE_READ-> delete -> VERSION_SET_READ -> target_one
+        auto delete_iter = table_delete_index.find(i_stmt_u.target_table);
+        if (delete_iter == table_delete_index.end())
+            continue;
+        for (auto j : delete_iter->second) {
             auto& j_tid = f_txn_id_queue[j];
-            // if (i_tid == j_tid)
-            //     continue;
-            // // skip if they donot interleave
-            // if (dependency_graph[i_tid][j_tid].count(STRICT_START_DEPEND) > 0)
-            //     continue;
-            // if (dependency_graph[j_tid][i_tid].count(STRICT_START_DEPEND) > 0)
-            //     continue;
-            
-            auto& j_stmt_u = f_stmt_usage[j];
-            if (j_stmt_u == UPDATE_WRITE || j_stmt_u == INSERT_WRITE) {
-                auto after_write_idx = j + 1;
-                if (f_stmt_usage[after_write_idx] != AFTER_WRITE_READ) {
-                    auto err_info = "[INSTRUMENT_ERR] build_VS_dependency: after_write_idx is not AFTER_WRITE_READ, after_write_idx = " + to_string(after_write_idx);
-                    cerr << err_info << endl;
-                    throw runtime_error(err_info);
-                }
-                auto& after_write_output = f_stmt_output[after_write_idx];
-                set<pair<int, int>> after_write_pv_pair_set; // primary_key, version_key
-                for (auto& row:after_write_output) {
-                    auto row_id = stoi(row[primary_key_index]);
-                    auto version_id = stoi(row[version_key_index]);
-                    pair<int, int> p(row_id, version_id);
-                    after_write_pv_pair_set.insert(p);
-                }
-
-                set<pair<int, int>> res;
-                set_intersection(i_pv_pair_set.begin(), i_pv_pair_set.end(), 
-                    after_write_pv_pair_set.begin(), after_write_pv_pair_set.end(),
-                    inserter(res, res.begin()));
-
-                if (!res.empty()) { // if it is not empty, the changed version is seen in version read
-                    if (i_tid != j_tid)
-                        dependency_graph[j_tid][i_tid].insert(VERSION_SET_DEPEND);
-                    build_stmt_depend_from_stmt_idx(after_write_idx, i, VERSION_SET_DEPEND);
-                    // update/insert -> AFTER_WRITE_READ -> VERSION_SET_READ -> target_one
-                }
-            }
-            else if (j_stmt_u == DELETE_WRITE) {
-                auto before_write_idx = j - 1;
-                if (f_stmt_usage[before_write_idx] != BEFORE_WRITE_READ) {
-                    auto err_info = "[INSTRUMENT_ERR] build_VS_dependency: before_write_idx is not BEFORE_WRITE_READ, before_write_idx = " + to_string(before_write_idx);
-                    cerr << err_info << endl;
-                    throw runtime_error(err_info);
-                }
-                // skip if they donot handle the same table
-                if (f_stmt_usage[before_write_idx].target_table == "" || i_stmt_u.target_table == "") {
-                    auto err_info = "[INSTRUMENT_ERR] build_VS_dependency: target_table is not initialized, before_write_idx = " + to_string(before_write_idx);
-                    cerr << err_info << endl;
-                    throw runtime_error(err_info);
-                }
-                if (f_stmt_usage[before_write_idx].target_table != i_stmt_u.target_table)
-                    continue;
-                
-                auto& before_write_output = f_stmt_output[before_write_idx];
-                if (before_write_output.empty()) // delete nothing, skip
-                    continue;
-
-                set<int> before_write_primary_set; // primary_key, version_key
-                for (auto& row:before_write_output) {
-                    auto row_id = stoi(row[primary_key_index]);
-                    before_write_primary_set.insert(row_id);
-                }
-
-                set<int> res;
-                set_intersection(i_primary_set.begin(), i_primary_set.begin(),
-                    before_write_primary_set.begin(), before_write_primary_set.begin(),
-                    inserter(res, res.begin()));
-                if (res.empty()) { // if it is emtpy, the row is deleted
-                    if (i_tid != j_tid)
-                        dependency_graph[j_tid][i_tid].insert(VERSION_SET_DEPEND);
-                    build_stmt_depend_from_stmt_idx(j, i, VERSION_SET_DEPEND);
-                    // BEFORE_WRITE_READ-> delete -> VERSION_SET_READ -> target_one
-                }
-            }
+            if (i_tid != j_tid)
+                dependency_graph.add_edge(j_tid, i_tid, VERSION_SET_DEPEND);
+            build_stmt_depend_from_stmt_idx(j, i, VERSION_SET_DEPEND);
         }
     }
 }
@@ -298,27 +423,56 @@ void dependency_analyzer::build_VS_dependency()
 // should be used after build_start_dependency
 void dependency_analyzer::build_OW_dependency()
 {
-    // if (tid_begin_idx == NULL || tid_strict_begin_idx == NULL || tid_end_idx == NULL) {
-    //     cerr << "you should not use build_VS_dependency before build_start_dependency" << endl;
-    //     throw runtime_error("you should not use build_VS_dependency before build_start_dependency");
-    // }
-
+    vector<int> version_set_reads;
     for (int i = 0; i < stmt_num; i++) {
+        if (f_stmt_usage[i] == VERSION_SET_READ)
+            version_set_reads.push_back(i);
+    }
+    if (version_set_reads.empty())
+        return;
+
+    // (primary_key, version_key) -> BEFORE_WRITE_READ of the update/delete that overwrites the version
+    map<pair<int, int>, vector<int>> overwritten_version_index;
+    // target_table -> insert (whose AFTER_WRITE_READ is not empty)
+    map<string, vector<int>> table_insert_index;
+    bool has_insert = false;
+    vector<pair<int, int>> pv_pairs;
+    for (int j = 0; j < stmt_num; j++) {
+        auto& j_stmt_u = f_stmt_usage[j];
+        if (j_stmt_u == UPDATE_WRITE || j_stmt_u == DELETE_WRITE) {
+            auto before_write_idx = j - 1;
+            if (before_write_idx < 0 || f_stmt_usage[before_write_idx] != BEFORE_WRITE_READ) {
+                auto err_info = "[INSTRUMENT_ERR] build_OW_dependency: before_write_idx is not BEFORE_WRITE_READ, before_write_idx = " + to_string(before_write_idx);
+                *report << err_info << endl;
+                throw runtime_error(err_info);
+            }
+            get_pv_pairs(before_write_idx, pv_pairs);
+            for (auto& pv : pv_pairs)
+                overwritten_version_index[pv].push_back(before_write_idx);
+        }
+        else if (j_stmt_u == INSERT_WRITE) {
+            auto after_write_idx = j + 1;
+            if (after_write_idx >= stmt_num || f_stmt_usage[after_write_idx] != AFTER_WRITE_READ) {
+                auto err_info = "[INSTRUMENT_ERR] build_OW_dependency: after_write_idx is not AFTER_WRITE_READ, after_write_idx = " + to_string(after_write_idx);
+                *report << err_info << endl;
+                throw runtime_error(err_info);
+            }
+            if (f_stmt_usage[after_write_idx].target_table == "") {
+                auto err_info = "[INSTRUMENT_ERR] build_OW_dependency: target_table is not initialized, after_write_idx = " + to_string(after_write_idx);
+                *report << err_info << endl;
+                throw runtime_error(err_info);
+            }
+            has_insert = true;
+            if (f_stmt_output[after_write_idx].empty()) // insert nothing, skip
+                continue;
+            table_insert_index[f_stmt_usage[after_write_idx].target_table].push_back(j);
+        }
+    }
+
+    vector<int> linked_read(stmt_num, -1); // the last version set read that an edge is built from
+    for (auto i : version_set_reads) {
         auto& i_stmt_u = f_stmt_usage[i];
-        if (i_stmt_u != VERSION_SET_READ)
-            continue;
         auto& i_tid = f_txn_id_queue[i];
-        auto& i_output = f_stmt_output[i];
-
-        set<pair<int, int>> i_pv_pair_set; // primary_key, version_key
-        set<int> i_primary_set; // primary_key
-        for (auto& row : i_output) {
-            auto row_id = stoi(row[primary_key_index]);
-            auto version_id = stoi(row[version_key_index]);
-            pair<int, int> p(row_id, version_id);
-            i_pv_pair_set.insert(p);
-            i_primary_set.insert(row_id);
-        }
 
         int orginal_index = -1;
         for (int j = i + 1; j < stmt_num; j++) {
@@ -332,7 +486,7 @@ void dependency_analyzer::build_OW_dependency()
         }
         if (orginal_index == -1) {
             auto err_info = "[INSTRUMENT_ERR] cannot find the orginal_index in build_OW_dependency";
-            cerr << err_info << endl;
+            *report << err_info << endl;
             throw runtime_error(err_info);
         }
         if (f_stmt_usage[orginal_index] == UPDATE_WRITE ||
@@ -340,133 +494,121 @@ void dependency_analyzer::build_OW_dependency()
             orginal_index++; // use after_write_read (SELECT_READ and DELETE_WRITE donot have awr)
             if (f_stmt_usage[orginal_index] != AFTER_WRITE_READ) {
                 auto err_info = "[INSTRUMENT_ERR] build_OW_dependency: orginal_index + 1 is not AFTER_WRITE_READ, orginal_index = " + to_string(orginal_index);
-                cerr << err_info << endl;
+                *report << err_info << endl;
                 throw runtime_error(err_info);
             }
         }
-            
-        for (int j = 0; j < stmt_num; j++) {
-            auto& j_tid = f_txn_id_queue[j];
-            // if (i_tid == j_tid)
-            //     continue;
-            // // skip if they donot interleave
-            // if (dependency_graph[i_tid][j_tid].count(STRICT_START_DEPEND) > 0)
-            //     continue;
-            // if (dependency_graph[j_tid][i_tid].count(STRICT_START_DEPEND) > 0)
-            //     continue;
-            
-            auto& j_stmt_u = f_stmt_usage[j];
-            if (j_stmt_u == UPDATE_WRITE || j_stmt_u == DELETE_WRITE) {
-                auto before_write_idx = j - 1;
-                if (f_stmt_usage[before_write_idx] != BEFORE_WRITE_READ) {
-                    auto err_info = "[INSTRUMENT_ERR] build_OW_dependency: before_write_idx is not BEFORE_WRITE_READ, before_write_idx = " + to_string(before_write_idx);
-                    cerr << err_info << endl;
-                    throw runtime_error(err_info);
-                }
-                auto& before_write_output = f_stmt_output[before_write_idx];
-                set<pair<int, int>> before_write_pv_pair_set; // primary_key, version_key
-                for (auto& row:before_write_output) {
-                    auto row_id = stoi(row[primary_key_index]);
-                    auto version_id = stoi(row[version_key_index]);
-                    pair<int, int> p(row_id, version_id);
-                    before_write_pv_pair_set.insert(p);
-                }
 
-                set<pair<int, int>> res;
-                set_intersection(i_pv_pair_set.begin(), i_pv_pair_set.end(), 
-                    before_write_pv_pair_set.begin(), before_write_pv_pair_set.end(),
-                    inserter(res, res.begin()));
-                if (!res.empty()) {
-                    if (i_tid != j_tid)
-                        dependency_graph[i_tid][j_tid].insert(OVERWRITE_DEPEND);
-                    build_stmt_depend_from_stmt_idx(orginal_index, before_write_idx, OVERWRITE_DEPEND);
-                    // version_set read -> target_one -> before_read -> update/delete
-                }
-            }
-            else if (j_stmt_u == INSERT_WRITE) {
-                auto after_write_idx = j + 1;
-                if (f_stmt_usage[after_write_idx] != AFTER_WRITE_READ) {
-                    auto err_info = "[INSTRUMENT_ERR] build_OW_dependency: after_write_idx is not AFTER_WRITE_READ, after_write_idx = " + to_string(after_write_idx);
-                    cerr << err_info << endl;
-                    throw runtime_error(err_info);
-                }
-                // skip if they donot handle the same table
-                if (f_stmt_usage[after_write_idx].target_table == "" || i_stmt_u.target_table == "") {
-                    auto err_info = "[INSTRUMENT_ERR] build_OW_dependency: target_table is not initialized, after_write_idx = " + to_string(after_write_idx);
-                    cerr << err_info << endl;
-                    throw runtime_error(err_info);
-                }
-                if (f_stmt_usage[after_write_idx].target_table != i_stmt_u.target_table)
-                    continue;
-                
-                auto& after_write_output = f_stmt_output[after_write_idx];
-                if (after_write_output.empty()) // insert nothing, skip
+        // the read version is overwritten
+        // version_set read -> target_one -> before_read -> update/delete
+        get_pv_pairs(i, pv_pairs);
+        for (auto& pv : pv_pairs) {
+            auto version_iter = overwritten_version_index.find(pv);
+            if (version_iter == overwritten_version_index.end())
+                continue;
+            for (auto before_write_idx : version_iter->second) {
+                if (linked_read[before_write_idx] == i)
                     continue;
-                set<int> after_write_primary_set;
-                for (auto& row : after_write_output) {
-                    auto row_id = stoi(row[primary_key_index]);
-                    after_write_primary_set.insert(row_id);
-                }
-                set<int> res;
-                set_intersection(i_primary_set.begin(), i_primary_set.begin(),
-                    after_write_primary_set.begin(), after_write_primary_set.begin(),
-                    inserter(res, res.begin()));
-                if (res.empty()) { // if it is emtpy, the row is not inserted yet
-                    if (i_tid != j_tid)
-                        dependency_graph[i_tid][j_tid].insert(OVERWRITE_DEPEND);
-                    build_stmt_depend_from_stmt_idx(orginal_index, j, OVERWRITE_DEPEND);
-                    // version_set read -> target_one -> insert -> after_read
-                }
+                linked_read[before_write_idx] = i;
+                auto& j_tid = f_txn_id_queue[before_write_idx];
+                if (i_tid != j_tid)
+                    dependency_graph.add_edge(i_tid, j_tid, OVERWRITE_DEPEND);
+                build_stmt_depend_from_stmt_idx(orginal_index, before_write_idx, OVERWRITE_DEPEND);
             }
         }
+
+        if (has_insert && i_stmt_u.target_table == "") {
+            auto err_info = "[INSTRUMENT_ERR] build_OW_dependency: target_table is not initialized, version_set_read_idx = " + to_string(i);
+            *report << err_info << endl;
+            throw runtime_error(err_info);
+        }
+        // every insert of the same table, the inserted rows are not matched with 
+        // the read ones (the intersection of them was always empty)
+        // version_set read -> target_one -> insert -> after_read
+        auto insert_iter = table_insert_index.find(i_stmt_u.target_table);
+        if (insert_iter == table_insert_index.end())
+            continue;
+        for (auto j : insert_iter->second) {
+            auto& j_tid = f_txn_id_queue[j];
+            if (i_tid != j_tid)
+                dependency_graph.add_edge(i_tid, j_tid, OVERWRITE_DEPEND);
+            build_stmt_depend_from_stmt_idx(orginal_index, j, OVERWRITE_DEPEND);
+        }
     }
 }
 
 void dependency_analyzer::build_start_dependency()
 {
     // count the second stmt as begin stmt, because some dbms donot use snapshot unless it read or write something
-    auto tid_has_used_begin = new bool[tid_num];
-    tid_strict_begin_idx = new int[tid_num];
-    tid_begin_idx = new int[tid_num];
-    tid_end_idx = new int[tid_num];
-    for (int i = 0; i < tid_num; i++) {
-        tid_strict_begin_idx[i] = -1;
-        tid_begin_idx[i] = -1;
-        tid_end_idx[i] = -1;
-        tid_has_used_begin[i] = false;
-    }
-    for (int i = 0; i < stmt_num; i++) {
-        auto tid = f_txn_id_queue[i];
+    tid_strict_begin_idx.assign(tid_num, -1);
+    tid_begin_idx.assign(tid_num, -1);
+    tid_end_idx.assign(tid_num, -1);
+    for (int tid = 0; tid < tid_num; tid++) {
+        auto& stmt_queue_idx = txn_stmt_queue_idx[tid];
+        if (stmt_queue_idx.empty())
+            continue;
         // skip the first stmt (i.e. start transaction)
-        if (tid_has_used_begin[tid] == false) {
-            tid_has_used_begin[tid] = true;
-            tid_strict_begin_idx[tid] = i;
+        tid_strict_begin_idx[tid] = stmt_queue_idx.front();
+        if (stmt_queue_idx.size() == 1)
             continue;
-        }
-        if (tid_begin_idx[tid] == -1)
-            tid_begin_idx[tid] = i;
-        if (tid_end_idx[tid] < i)
-            tid_end_idx[tid] = i;
+        tid_begin_idx[tid] = stmt_queue_idx[1];
+        tid_end_idx[tid] = stmt_queue_idx.back();
     }
-    for (int i = 0; i < tid_num; i++) {
-        for (int j = 0; j < tid_num; j++) {
+
+    // sweep: the txns ending before the begin of txn j are a prefix of the txns sorted by end
+    vector<int> end_sorted_tid(tid_num);
+    for (int i = 0; i < tid_num; i++)
+        end_sorted_tid[i] = i;
+    sort(end_sorted_tid.begin(), end_sorted_tid.end(), [&](int a, int b) { 
+        return tid_end_idx[a] < tid_end_idx[b]; 
+    });
+    for (int j = 0; j < tid_num; j++) {
+        for (auto i : end_sorted_tid) {
+            if (tid_end_idx[i] >= tid_strict_begin_idx[j])
+                break;
             if (i == j)
                 continue;
-            if (tid_end_idx[i] < tid_begin_idx[j]) {
-                dependency_graph[i][j].insert(START_DEPEND);
-                build_stmt_start_dependency(i, j, START_DEPEND);
-            }
-            if (tid_end_idx[i] < tid_strict_begin_idx[j]) {
-                dependency_graph[i][j].insert(STRICT_START_DEPEND);
-                build_stmt_start_dependency(i, j, STRICT_START_DEPEND);
-            }
+            dependency_graph.add_edge(i, j, STRICT_START_DEPEND);
+            build_stmt_start_dependency(i, j, STRICT_START_DEPEND);
+        }
+        for (auto i : end_sorted_tid) {
+            if (tid_end_idx[i] >= tid_begin_idx[j])
+                break;
+            if (i == j)
+                continue;
+            dependency_graph.add_edge(i, j, START_DEPEND);
+            build_stmt_start_dependency(i, j, START_DEPEND);
         }
     }
-    delete[] tid_has_used_begin;
+}
+
+int dependency_analyzer::find_instrument_root(vector<int>& group_dad, int idx)
+{
+    auto root = idx;
+    while (group_dad[root] != root)
+        root = group_dad[root];
+    while (group_dad[idx] != root) { // path compression
+        auto next = group_dad[idx];
+        group_dad[idx] = root;
+        idx = next;
+    }
+    return root;
+}
+
+void dependency_analyzer::union_instrument_group(vector<int>& group_dad, int idx1, int idx2)
+{
+    auto root1 = find_instrument_root(group_dad, idx1);
+    auto root2 = find_instrument_root(group_dad, idx2);
+    if (root1 != root2)
+        group_dad[max(root1, root2)] = min(root1, root2);
 }
 
 void dependency_analyzer::build_stmt_instrument_dependency()
 {
+    vector<int> group_dad(stmt_num);
+    for (int i = 0; i < stmt_num; i++)
+        group_dad[i] = i;
+    instrument_links.clear();
     for (int i = 0; i < stmt_num; i++) {
         auto cur_usage = f_stmt_usage[i];
         auto cur_tid = f_txn_id_queue[i];
@@ -474,7 +616,7 @@ void dependency_analyzer::build_stmt_instrument_dependency()
         if (cur_usage == BEFORE_WRITE_READ) {
             if (i + 1 >= stmt_num) {
                 auto err_info = "[INSTRUMENT_ERR] i = BEFORE_WRITE_READ, i + 1 >= stmt_num, i = " + to_string(i);
-                cerr << err_info << endl;
+                *report << err_info << endl;
                 throw runtime_error(err_info);
             }
                 
@@ -482,22 +624,23 @@ void dependency_analyzer::build_stmt_instrument_dependency()
             auto next_usage = f_stmt_usage[i + 1];
             if (next_tid != cur_tid) {
                 auto err_info = "[INSTRUMENT_ERR] BEFORE_WRITE_READ: next_tid != cur_tid, i = " + to_string(i);
-                cerr << err_info << endl;
+                *report << err_info << endl;
                 throw runtime_error(err_info);
             }
 
             if (next_usage != UPDATE_WRITE && next_usage != DELETE_WRITE) {
                 auto err_info = "[INSTRUMENT_ERR] BEFORE_WRITE_READ: next_usage != UPDATE_WRITE && next_usage != DELETE_WRITE, i = " + to_string(i);
-                cerr << err_info << endl;
+                *report << err_info << endl;
                 throw runtime_error(err_info);
             }
 
-            build_stmt_depend_from_stmt_idx(i, i + 1, INSTRUMENT_DEPEND);
+            instrument_links.push_back(make_pair(i, i + 1));
+            union_instrument_group(group_dad, i, i + 1);
         }
         else if (cur_usage == AFTER_WRITE_READ) {
             if (i - 1 < 0) {
                 auto err_info = "[INSTRUMENT_ERR] i = AFTER_WRITE_READ, i - 1 < 0, i = " + to_string(i);
-                cerr << err_info << endl;
+                *report << err_info << endl;
                 throw runtime_error(err_info);
             }
 
@@ -505,17 +648,18 @@ void dependency_analyzer::build_stmt_instrument_dependency()
             auto prev_usage = f_stmt_usage[i - 1];
             if (prev_tid != cur_tid) {
                 auto err_info = "[INSTRUMENT_ERR] AFTER_WRITE_READ: prev_tid != cur_tid, i = " + to_string(i);
-                cerr << err_info << endl;
+                *report << err_info << endl;
                 throw runtime_error(err_info);
             }
 
             if (prev_usage != UPDATE_WRITE && prev_usage != INSERT_WRITE) {
                 auto err_info = "[INSTRUMENT_ERR] AFTER_WRITE_READ: prev_tid != UPDATE_WRITE && prev_tid != INSERT_WRITE, i = " + to_string(i);
-                cerr << err_info << endl;
+                *report << err_info << endl;
                 throw runtime_error(err_info);
             }
 
-            build_stmt_depend_from_stmt_idx(i - 1, i, INSTRUMENT_DEPEND);
+            instrument_links.push_back(make_pair(i - 1, i));
+            union_instrument_group(group_dad, i - 1, i);
         }
         else if (cur_usage == VERSION_SET_READ) {
             int normal_pos = i + 1;
@@ -524,7 +668,7 @@ void dependency_analyzer::build_stmt_instrument_dependency()
                 auto next_usage = f_stmt_usage[normal_pos];
                 if (next_tid != cur_tid) {
                     auto err_info = "[INSTRUMENT_ERR] VERSION_SET_READ: next_tid != cur_tid, cur: " + to_string(i) + " next: " + to_string(normal_pos);
-                    cerr << err_info << endl;
+                    *report << err_info << endl;
                     throw runtime_error(err_info);
                 }
                 if (next_usage == SELECT_READ || 
@@ -537,113 +681,225 @@ void dependency_analyzer::build_stmt_instrument_dependency()
 
             if (normal_pos == stmt_num) {
                 auto err_info = "[INSTRUMENT_ERR] VERSION_SET_READ: cannot find the normal one, cur: " + to_string(i);
-                cerr << err_info << endl;
+                *report << err_info << endl;
                 throw runtime_error(err_info);
             }
 
-            build_stmt_depend_from_stmt_idx(i, normal_pos, INSTRUMENT_DEPEND);
+            instrument_links.push_back(make_pair(i, normal_pos));
+            union_instrument_group(group_dad, i, normal_pos);
         }
     }
+
+    // groups are numbered by their first stmt, members are in ascending order
+    instrument_group_of.assign(stmt_num, -1);
+    vector<int> root_to_group(stmt_num, -1);
+    vector<int> group_size;
+    for (int i = 0; i < stmt_num; i++) {
+        auto root = find_instrument_root(group_dad, i);
+        if (root_to_group[root] == -1) {
+            root_to_group[root] = group_size.size();
+            group_size.push_back(0);
+        }
+        instrument_group_of[i] = root_to_group[root];
+        group_size[instrument_group_of[i]]++;
+    }
+    instrument_group_num = group_size.size();
+    instrument_group_begin.assign(instrument_group_num + 1, 0);
+    for (int g = 0; g < instrument_group_num; g++)
+        instrument_group_begin[g + 1] = instrument_group_begin[g] + group_size[g];
+    instrument_group_members.assign(stmt_num, -1);
+    vector<int> fill_pos(instrument_group_begin.begin(), instrument_group_begin.end() - 1);
+    for (int i = 0; i < stmt_num; i++)
+        instrument_group_members[fill_pos[instrument_group_of[i]]++] = i;
+    sort(instrument_links.begin(), instrument_links.end());
 }
 
 set<int> dependency_analyzer::get_instrumented_stmt_set(int queue_idx)
 {
-    set<int> init_idx_set;
-    set<int> processed_idx_set;
-    init_idx_set.insert(queue_idx);
-    while (!init_idx_set.empty()) {
-        auto select_idx = *init_idx_set.begin();
-        init_idx_set.erase(select_idx);
-        processed_idx_set.insert(select_idx);
-
-        auto stmt_id1 = stmt_id(f_txn_id_queue, select_idx);
-        for (int i = 0; i < stmt_num; i++) {
-            if (processed_idx_set.count(i) > 0) // has been processed
-                continue;
-            auto stmt_id2 = stmt_id(f_txn_id_queue, i);
-            pair<stmt_id, stmt_id> instrument_pair;
-            if (i < select_idx)
-                instrument_pair = make_pair<>(stmt_id2, stmt_id1);
-            else
-                instrument_pair = make_pair<>(stmt_id1, stmt_id2);
-            if (stmt_dependency_graph[instrument_pair].count(INSTRUMENT_DEPEND) > 0)
-                init_idx_set.insert(i);
-        }
-    }
-    return processed_idx_set;
+    auto g = instrument_group_of[queue_idx];
+    return set<int>(group_begin(g), group_end(g));
 }
 
+// in large_history mode the inner and start edges of the stmts are implicit (see get_stmt_depend)
 void dependency_analyzer::build_stmt_inner_dependency()
 {
-    for (int i = 0; i < stmt_num; i++) {
-        auto tid = f_txn_id_queue[i];
-        for (int j = 0; j < i; j++) {
-            auto prev_tid = f_txn_id_queue[j];
-            if (prev_tid == tid) 
-                build_stmt_depend_from_stmt_idx(j, i, INNER_DEPEND);
+    if (large_history)
+        return;
+    for (int tid = 0; tid < tid_num; tid++) {
+        auto& stmt_queue_idx = txn_stmt_queue_idx[tid];
+        auto txn_size = stmt_queue_idx.size();
+        for (int i = 0; i < txn_size; i++) {
+            for (int j = 0; j < i; j++) 
+                build_stmt_depend_from_stmt_idx(stmt_queue_idx[j], stmt_queue_idx[i], INNER_DEPEND);
         }
     }
 }
 
 void dependency_analyzer::build_stmt_start_dependency(int prev_tid, int later_tid, dependency_type dt)
 {
-    for (int i = 0; i < stmt_num; i++) {
-        auto i_tid = f_txn_id_queue[i];
-        if (i_tid != prev_tid)
+    if (large_history)
+        return;
+    auto& prev_queue_idx = txn_stmt_queue_idx[prev_tid];
+    auto& later_queue_idx = txn_stmt_queue_idx[later_tid];
+    for (auto i : prev_queue_idx) {
+        auto j_it = upper_bound(later_queue_idx.begin(), later_queue_idx.end(), i);
+        for (; j_it != later_queue_idx.end(); j_it++)
+            build_stmt_depend_from_stmt_idx(i, *j_it, dt);
+    }
+}
+
+void dependency_analyzer::update_group_degree(int stmt_idx, int delta, vector<int>& in_degree, 
+                                                vector<int>& out_degree, const vector<bool>& removed)
+{
+    auto g = instrument_group_of[stmt_idx];
+    for (auto j : stmt_dependency_graph.out_list[stmt_idx]) {
+        auto h = instrument_group_of[j];
+        if (h == g || removed[j] || (stmt_dependency_graph.get(stmt_idx, j) & ~TOPO_SORT_ORDER_TYPES) == 0)
             continue;
-        for (int j = i + 1; j < stmt_num; j++) {
-            auto j_tid = f_txn_id_queue[j];
-            if (j_tid != later_tid)
-                continue;
-            
-            build_stmt_depend_from_stmt_idx(i, j, dt);
+        out_degree[g] += delta;
+        in_degree[h] += delta;
+    }
+    for (auto j : stmt_dependency_graph.in_list[stmt_idx]) {
+        auto h = instrument_group_of[j];
+        if (h == g || removed[j] || (stmt_dependency_graph.get(j, stmt_idx) & ~TOPO_SORT_ORDER_TYPES) == 0)
+            continue;
+        out_degree[h] += delta;
+        in_degree[g] += delta;
+    }
+}
+
+void dependency_analyzer::delete_stmt(int queue_idx)
+{
+    if (stmt_deleted[queue_idx])
+        return;
+    update_group_degree(queue_idx, -1, group_in_degree, group_out_degree, stmt_deleted);
+    stmt_dependency_graph.delete_node(queue_idx);
+    stmt_deleted[queue_idx] = true;
+}
+
+depend_mask dependency_analyzer::get_stmt_depend(int stmt_idx1, int stmt_idx2)
+{
+    auto depend_set = stmt_dependency_graph.get(stmt_idx1, stmt_idx2);
+    if (binary_search(instrument_links.begin(), instrument_links.end(), make_pair(stmt_idx1, stmt_idx2)))
+        depend_set |= DEPEND_BIT(INSTRUMENT_DEPEND);
+    if (!large_history || stmt_idx1 >= stmt_idx2)
+        return depend_set;
+    auto tid1 = f_txn_id_queue[stmt_idx1];
+    auto tid2 = f_txn_id_queue[stmt_idx2];
+    if (tid1 == tid2)
+        return depend_set | DEPEND_BIT(INNER_DEPEND);
+    if (dependency_graph.has_type(tid1, tid2, START_DEPEND))
+        depend_set |= DEPEND_BIT(START_DEPEND);
+    if (dependency_graph.has_type(tid1, tid2, STRICT_START_DEPEND))
+        depend_set |= DEPEND_BIT(STRICT_START_DEPEND);
+    return depend_set;
+}
+
+void dependency_analyzer::get_first_live_from(const vector<bool>& live, vector<int>& first_live_from)
+{
+    first_live_from.assign(stmt_num, -1);
+    for (auto& stmt_queue_idx : txn_stmt_queue_idx) {
+        int next_live = -1;
+        for (int k = (int)stmt_queue_idx.size() - 1; k >= 0; k--) {
+            auto i = stmt_queue_idx[k];
+            if (live[i])
+                next_live = i;
+            first_live_from[i] = next_live;
+        }
+    }
+}
+
+void dependency_analyzer::stmt_out_nodes(int i, depend_mask edge_types, const vector<int>& first_live_from, vector<int>& res)
+{
+    res.clear();
+    auto is_live = [&](int j) { return first_live_from[j] == j; };
+    for (auto j : stmt_dependency_graph.out_list[i]) {
+        if (is_live(j) && (stmt_dependency_graph.get(i, j) & edge_types) != 0)
+            res.push_back(j);
+    }
+    if (edge_types & DEPEND_BIT(INSTRUMENT_DEPEND)) {
+        auto link = lower_bound(instrument_links.begin(), instrument_links.end(), make_pair(i, 0));
+        for (; link != instrument_links.end() && link->first == i; link++) {
+            if (is_live(link->second))
+                res.push_back(link->second);
+        }
+    }
+
+    if (large_history) {
+        auto tid = f_txn_id_queue[i];
+        auto& own_queue_idx = txn_stmt_queue_idx[tid];
+        bool walk_inner = edge_types & DEPEND_BIT(INNER_DEPEND);
+        if (walk_inner) {
+            auto next_it = upper_bound(own_queue_idx.begin(), own_queue_idx.end(), i);
+            if (next_it != own_queue_idx.end() && first_live_from[*next_it] != -1)
+                res.push_back(first_live_from[*next_it]);
+        }
+        auto start_types = edge_types & (DEPEND_BIT(START_DEPEND) | DEPEND_BIT(STRICT_START_DEPEND));
+        if (start_types != 0) {
+            for (int later_tid = 0; later_tid < tid_num; later_tid++) {
+                if ((dependency_graph.get(tid, later_tid) & start_types) == 0)
+                    continue;
+                auto& later_queue_idx = txn_stmt_queue_idx[later_tid];
+                auto j_it = upper_bound(later_queue_idx.begin(), later_queue_idx.end(), i);
+                for (; j_it != later_queue_idx.end(); j_it++) {
+                    auto j = first_live_from[*j_it];
+                    if (j == -1)
+                        break;
+                    res.push_back(j);
+                    if (walk_inner)
+                        break;
+                    j_it = lower_bound(j_it, later_queue_idx.end(), j);
+                }
+            }
         }
     }
+    sort(res.begin(), res.end());
+    res.erase(unique(res.begin(), res.end()), res.end());
 }
 
 void dependency_analyzer::print_dependency_graph()
 {
-    cerr << "  ";
+    *report << "  ";
     for (int i = 0; i < tid_num; i++) {
         if (i < 10)
-            cerr << "|     " << i;
+            *report << "|     " << i;
         else
-            cerr << "|    " << i;
+            *report << "|    " << i;
     }
-    cerr << "|" << endl;
+    *report << "|" << endl;
     for (int i = 0; i < tid_num; i++) {
         if (i < 10)
-            cerr << " " << i;
+            *report << " " << i;
         else
-            cerr << i;
+            *report << i;
         for (int j = 0; j < tid_num; j++) {
-            cerr << "|";
-            if (dependency_graph[i][j].count(WRITE_READ))
-                cerr << "0";
+            *report << "|";
+            if (dependency_graph.has_type(i, j, WRITE_READ))
+                *report << "0";
             else
-                cerr << " ";
-            if (dependency_graph[i][j].count(WRITE_WRITE))
-                cerr << "1";
+                *report << " ";
+            if (dependency_graph.has_type(i, j, WRITE_WRITE))
+                *report << "1";
             else
-                cerr << " ";
-            if (dependency_graph[i][j].count(READ_WRITE))
-                cerr << "2";
+                *report << " ";
+            if (dependency_graph.has_type(i, j, READ_WRITE))
+                *report << "2";
             else
-                cerr << " ";
-            if (dependency_graph[i][j].count(VERSION_SET_DEPEND))
-                cerr << "3";
+                *report << " ";
+            if (dependency_graph.has_type(i, j, VERSION_SET_DEPEND))
+                *report << "3";
             else
-                cerr << " ";
-            if (dependency_graph[i][j].count(OVERWRITE_DEPEND))
-                cerr << "4";
+                *report << " ";
+            if (dependency_graph.has_type(i, j, OVERWRITE_DEPEND))
+                *report << "4";
             else
-                cerr << " ";
-            if (dependency_graph[i][j].count(STRICT_START_DEPEND))
-                cerr << "5";
+                *report << " ";
+            if (dependency_graph.has_type(i, j, STRICT_START_DEPEND))
+                *report << "5";
             else
-                cerr << " ";
+                *report << " ";
         }
-        cerr << "|" << endl;
+        *report << "|" << endl;
     }
 }
 
@@ -655,37 +911,65 @@ dependency_analyzer::dependency_analyzer(vector<stmt_output>& init_output,
                         int t_num,
                         int primary_key_idx,
                         int write_op_key_idx):
-tid_num(t_num + 1),  // add 1 for init txn
-tid_begin_idx(NULL),
-tid_strict_begin_idx(NULL),
-tid_end_idx(NULL), 
-primary_key_index(primary_key_idx),
-version_key_index(write_op_key_idx),
-f_txn_status(final_txn_status),
-f_txn_id_queue(final_tid_queue),
-f_stmt_usage(final_stmt_usage),
-f_stmt_output(total_output)
+report(&cerr)
+{
+    reset(init_output, total_output, final_tid_queue, final_stmt_usage, 
+        final_txn_status, t_num, primary_key_idx, write_op_key_idx);
+}
+
+void dependency_analyzer::reset(const vector<stmt_output>& init_output,
+                        stmt_output_view total_output,
+                        const vector<int>& final_tid_queue,
+                        const vector<stmt_usage>& final_stmt_usage,
+                        const vector<txn_status>& final_txn_status,
+                        int t_num,
+                        int primary_key_idx,
+                        int write_op_key_idx)
 {   
+    tid_num = t_num + 1; // add 1 for init txn
+    primary_key_index = primary_key_idx;
+    version_key_index = write_op_key_idx;
+    f_txn_status.assign(final_txn_status.begin(), final_txn_status.end());
+    f_txn_id_queue.assign(final_tid_queue.begin(), final_tid_queue.end());
+    f_stmt_usage.assign(final_stmt_usage.begin(), final_stmt_usage.end());
+    f_stmt_output = total_output;
+    h.clear();
+    rows.clear();
+    txn_reach.clear();
+
     if (f_stmt_output.size() != f_txn_id_queue.size() || f_stmt_output.size() != f_stmt_usage.size()) {
-        cerr << "dependency_analyzer: total_output, final_tid_queue and final_stmt_usage size are not equal" << endl;
+        *report << "dependency_analyzer: total_output, final_tid_queue and final_stmt_usage size are not equal" << endl;
         throw runtime_error("dependency_analyzer: total_output, final_tid_queue and final_stmt_usage size are not equal");
     }
     stmt_num = f_stmt_output.size();
     
     f_txn_status.push_back(TXN_COMMIT); // for init txn;
 
-    for (int txn_id = 0; txn_id < tid_num; txn_id++) {
-        int txn_stmt_num = 0;
-        for (int i = 0; i < stmt_num; i++) {
-            if (f_txn_id_queue[i] == txn_id)
-                txn_stmt_num++;
+    for (auto& stmt_queue_idx : txn_stmt_queue_idx)
+        stmt_queue_idx.clear();
+    txn_stmt_queue_idx.resize(tid_num);
+    queue_idx_to_stmt_id.clear();
+    for (int i = 0; i < stmt_num; i++) {
+        auto tid = f_txn_id_queue[i];
+        if (tid < 0 || tid >= tid_num) {
+            *report << "dependency_analyzer: illegal tid in final_tid_queue: " << tid << endl;
+            throw runtime_error("dependency_analyzer: illegal tid in final_tid_queue");
         }
-        f_txn_size.push_back(txn_stmt_num);
-    }
+        queue_idx_to_stmt_id.push_back(stmt_id(tid, txn_stmt_queue_idx[tid].size()));
+        txn_stmt_queue_idx[tid].push_back(i);
+    }
+    f_txn_size.clear();
+    for (int txn_id = 0; txn_id < tid_num; txn_id++) 
+        f_txn_size.push_back(txn_stmt_queue_idx[txn_id].size());
+    large_history = stmt_num >= LARGE_HISTORY_STMT_NUM;
+    stmt_dependency_graph.reset(stmt_num, large_history);
     
-    dependency_graph = new set<dependency_type>* [tid_num];
-    for (int i = 0; i < tid_num; i++) 
-        dependency_graph[i] = new set<dependency_type> [tid_num];
+    dependency_graph.reset(tid_num);
+    committed_txn.assign(dependency_graph.word_num, 0);
+    for (int i = 0; i < tid_num; i++) {
+        if (f_txn_status[i] == TXN_COMMIT)
+            committed_txn[i / BITSET_WORD_BITS] |= 1ULL << (i % BITSET_WORD_BITS);
+    }
     
     for (auto& each_output : init_output) {
         if (each_output.empty())
@@ -693,9 +977,8 @@ f_stmt_output(total_output)
         for (auto& row : each_output) {
             auto row_id = stoi(row[primary_key_idx]);
             auto write_op_id = stoi(row[write_op_key_idx]);
-            auto hash = hash_output(row);
-            hash_to_output[hash] = row;
-            operate_unit op(stmt_usage(AFTER_WRITE_READ, false), write_op_id, tid_num - 1, -1, row_id, hash);
+            auto row_ref = rows.intern(row);
+            operate_unit op(stmt_usage(AFTER_WRITE_READ, false), write_op_id, tid_num - 1, -1, row_id, row_ref);
             h.insert_to_history(op);
         }
     }
@@ -713,9 +996,8 @@ f_stmt_output(total_output)
         for (auto& row : each_output) {
             auto row_id = stoi(row[primary_key_idx]);
             auto write_op_id = stoi(row[write_op_key_idx]);
-            auto hash = hash_output(row);
-            hash_to_output[hash] = row;
-            operate_unit op(stmt_u, write_op_id, tid, i, row_id, hash);
+            auto row_ref = rows.intern(row);
+            operate_unit op(stmt_u, write_op_id, tid, i, row_id, row_ref);
             h.insert_to_history(op);
         }
     }
@@ -723,9 +1005,12 @@ f_stmt_output(total_output)
     // first build instrument dependency, make sure that the instrument is correct
     build_stmt_instrument_dependency();
 
-    // generate ww, wr, rw dependency
-    for (auto& row_history : h.change_history) {
-        auto& row_op_list = row_history.row_op_list;
+    // generate ww, wr, rw dependency, and classify the reads for G1a and G1b
+    g1a_abort_tid = g1a_commit_tid = -1;
+    g1b_row_idx = g1b_first_write_idx = g1b_other_read_idx = g1b_second_write_idx = -1;
+    auto row_num = h.change_history.size();
+    for (int row_idx = 0; row_idx < row_num; row_idx++) {
+        auto& row_op_list = h.change_history[row_idx].row_op_list;
         auto size = row_op_list.size();
         for (int i = 0; i < size; i++) {
             auto& op_unit = row_op_list[i];
@@ -739,6 +1024,8 @@ f_stmt_output(total_output)
                 build_RW_dependency(row_op_list, i);
             }
         }
+        if (g1b_row_idx == -1) // only the first one is reported
+            classify_intermediate_reads(row_op_list, row_idx);
     }
 
     // // generate start dependency (for snapshot)
@@ -751,19 +1038,25 @@ f_stmt_output(total_output)
     // generate stmt inner depend
     build_stmt_inner_dependency();
     
+    stmt_dependency_graph.compact();
+
+    stmt_deleted.assign(stmt_num, false);
+    group_in_degree.assign(instrument_group_num, 0);
+    group_out_degree.assign(instrument_group_num, 0);
+    for (int i = 0; i < stmt_num; i++) {
+        auto g = instrument_group_of[i];
+        for (auto j : stmt_dependency_graph.out_list[i]) {
+            if (instrument_group_of[j] == g || (stmt_dependency_graph.get(i, j) & ~TOPO_SORT_ORDER_TYPES) == 0)
+                continue;
+            group_out_degree[g]++;
+            group_in_degree[instrument_group_of[j]]++;
+        }
+    }
+    
     // // print dependency graph
     // print_dependency_graph();
-}
-
-dependency_analyzer::~dependency_analyzer()
-{
-    delete[] tid_end_idx;
-    delete[] tid_begin_idx;
-    delete[] tid_strict_begin_idx;
 
-    for (int i = 0; i < tid_num; i++) 
-        delete[] dependency_graph[i];
-    delete[] dependency_graph;
+    f_stmt_output = stmt_output_view();
 }
 
 // G1a: Aborted Reads. A history H exhibits phenomenon G1a if it contains an aborted
@@ -774,24 +1067,11 @@ dependency_analyzer::~dependency_analyzer()
 // wi(xi:m) ... rj(P: xi:m, ...) ... (ai and cj in any order)
 bool dependency_analyzer::check_G1a()
 {
-    // check whether there is a read dependency from Ti to Tj that is aborted
-    for (int j = 0; j < tid_num; j++) {
-        if (f_txn_status[j] != TXN_ABORT)
-            continue; // txn j must be aborted
-        
-        for (int i = 0; i < tid_num; i++) {
-            if (f_txn_status[i] != TXN_COMMIT)
-                continue; // txn i must be committed
-            
-            auto& dependencies = dependency_graph[j][i]; // j(abort) -> WR -> i(commit) [i wr depend on j]
-            if (dependencies.count(WRITE_READ) > 0) {
-                cerr << "abort txn: " << j << endl;
-                cerr << "commit txn: " << i << endl;
-                return true;
-            }    
-        }
-    }
-    return false;
+    if (g1a_abort_tid == -1)
+        return false;
+    *report << "abort txn: " << g1a_abort_tid << endl;
+    *report << "commit txn: " << g1a_commit_tid << endl;
+    return true;
 }
 
 // G1b: Intermediate Reads. A history H exhibits phenomenon G1b if it contains a
@@ -802,274 +1082,419 @@ bool dependency_analyzer::check_G1a()
 // wi(xi:m) ... rj(P: xi:m, ...) ... wi(xi:n) ... cj
 bool dependency_analyzer::check_G1b()
 {
-    for (auto& rch : h.change_history) {
-        auto& op_list = rch.row_op_list;
-        auto opl_size = op_list.size();
-        for (int i = 0; i < opl_size; i++) {
-            if (op_list[i].stmt_u != AFTER_WRITE_READ)
-                continue;
-            
-            int wop_id = op_list[i].write_op_id;
-            int tid = op_list[i].tid;
-            int txn_end_idx = tid_end_idx[tid];
-            int other_read_idx = -1;
-            int second_write_idx = -1;
-            
-            for (int j = i + 1; j < opl_size; j++) {
-                if (op_list[j].stmt_idx > txn_end_idx)
-                    break; // the later stmt will not contain the write from txn i
-                
-                // check whether the earlier version is read
-                if (other_read_idx == -1 && 
-                        op_list[j].write_op_id == wop_id &&
-                        op_list[j].tid != tid)
-                    other_read_idx = j;
-                
-                // check whether it will be rewrite by itself
-                if (second_write_idx == -1 &&
-                        op_list[j].tid == tid &&
-                        op_list[j].stmt_u == BEFORE_WRITE_READ)
-                    second_write_idx = j;
-                
-                if (other_read_idx >= 0 && second_write_idx >= 0) {
-                    cerr << "first_write_idx: " << i << endl;
-                    cerr << "tid: " << tid << endl;
-                    cerr << "outpout: " << endl;
-                    auto& first_write_row = hash_to_output[op_list[i].hash];
-                    for (int e = 0; e < first_write_row.size(); e++)
-                        cerr << first_write_row[e] << " ";
-                    cerr << endl;
-                    
-                    cerr << "other_read_idx: " << other_read_idx << endl;
-                    cerr << "tid: " << op_list[other_read_idx].tid << endl;
-                    cerr << "outpout: " << endl;
-                    auto& read_row = hash_to_output[op_list[other_read_idx].hash];
-                    for (int e = 0; e < read_row.size(); e++)
-                        cerr << read_row[e] << " ";
-                    cerr << endl;
-
-                    cerr << "second_write_idx: " << second_write_idx << endl;
-                    cerr << "tid: " << op_list[second_write_idx].tid << endl;
-                    
-                    return true;
+    if (g1b_row_idx == -1)
+        return false;
+    auto& op_list = h.change_history[g1b_row_idx].row_op_list;
+    auto tid = op_list[g1b_first_write_idx].tid;
+    *report << "first_write_idx: " << g1b_first_write_idx << endl;
+    *report << "tid: " << tid << endl;
+    *report << "outpout: " << endl;
+    auto& first_write_row = rows.get(op_list[g1b_first_write_idx].row_ref);
+    for (int e = 0; e < first_write_row.size(); e++)
+        *report << first_write_row[e] << " ";
+    *report << endl;
+    
+    *report << "other_read_idx: " << g1b_other_read_idx << endl;
+    *report << "tid: " << op_list[g1b_other_read_idx].tid << endl;
+    *report << "outpout: " << endl;
+    auto& read_row = rows.get(op_list[g1b_other_read_idx].row_ref);
+    for (int e = 0; e < read_row.size(); e++)
+        *report << read_row[e] << " ";
+    *report << endl;
+
+    *report << "second_write_idx: " << g1b_second_write_idx << endl;
+    *report << "tid: " << op_list[g1b_second_write_idx].tid << endl;
+    return true;
+}
+
+// one backward walk of op_list: a write wi(xi:m) is an intermediate one if, before the end 
+// of Ti, another txn reads xi:m and Ti writes x again. the nearest such read and rewrite 
+// are kept for each write_op_id and tid
+void dependency_analyzer::classify_intermediate_reads(vector<operate_unit>& op_list, int row_idx)
+{
+    struct version_reads {
+        int nearest_idx; // the nearest later op of the version
+        int nearest_tid;
+        int other_tid_idx; // the nearest later op of the version not in nearest_tid
+    };
+    unordered_map<int, version_reads> later_reads; // write_op_id -> reads
+    unordered_map<int, int> later_rewrite; // tid -> the nearest later BEFORE_WRITE_READ
+    
+    int found_idx = -1;
+    for (int i = (int)op_list.size() - 1; i >= 0; i--) {
+        auto& op = op_list[i];
+        if (op.stmt_u == AFTER_WRITE_READ) {
+            auto& txn_queue_idx = txn_stmt_queue_idx[op.tid];
+            int txn_end_idx = txn_queue_idx.size() > 1 ? txn_queue_idx.back() : -1; // as tid_end_idx
+            auto read_it = later_reads.find(op.write_op_id);
+            auto rewrite_it = later_rewrite.find(op.tid);
+            if (read_it != later_reads.end() && rewrite_it != later_rewrite.end()) {
+                auto other_read_idx = read_it->second.nearest_tid != op.tid ? 
+                                    read_it->second.nearest_idx : read_it->second.other_tid_idx;
+                auto second_write_idx = rewrite_it->second;
+                if (other_read_idx != -1 && 
+                        op_list[other_read_idx].stmt_idx <= txn_end_idx &&
+                        op_list[second_write_idx].stmt_idx <= txn_end_idx) {
+                    found_idx = i;
+                    g1b_other_read_idx = other_read_idx;
+                    g1b_second_write_idx = second_write_idx;
                 }
-                    
             }
         }
+
+        auto read_it = later_reads.find(op.write_op_id);
+        if (read_it == later_reads.end()) {
+            later_reads[op.write_op_id] = {i, op.tid, -1};
+        } else {
+            auto& reads = read_it->second;
+            if (reads.nearest_tid != op.tid)
+                reads.other_tid_idx = reads.nearest_idx;
+            reads.nearest_idx = i;
+            reads.nearest_tid = op.tid;
+        }
+        if (op.stmt_u == BEFORE_WRITE_READ)
+            later_rewrite[op.tid] = i;
     }
+    if (found_idx == -1)
+        return;
+    g1b_row_idx = row_idx;
+    g1b_first_write_idx = found_idx;
+}
 
-    return false;
+depend_mask txn_graph::get(int from, int to) const
+{
+    depend_mask mask = 0;
+    for (int dt = 0; dt < DEPEND_TYPE_NUM; dt++) {
+        if ((row(dt, from)[to / BITSET_WORD_BITS] >> (to % BITSET_WORD_BITS)) & 1)
+            mask |= DEPEND_BIT(dt);
+    }
+    return mask;
 }
 
-// recursively remove the node have 0 in-degree
-// return false if graph is empty after reduction, otherwise true
-bool dependency_analyzer::reduce_graph_indegree(int **direct_graph, int length)
+bool dependency_analyzer::txn_reachable(int from, int to)
 {
-    set<int> deleted_nodes;
-    while (1) {
-        // check whether the graph is empty
-        if (deleted_nodes.size() == length)
-            return false;
-        
-        // find a node whose in-degree is 0
-        int zero_indegree_idx = -1;
-        for (int i = 0; i < length; i++) {
-            if (deleted_nodes.count(i) > 0)
+    auto word_num = dependency_graph.word_num;
+    return (txn_reach[(size_t)from * word_num + to / BITSET_WORD_BITS] >> (to % BITSET_WORD_BITS)) & 1;
+}
+
+// txn_reach = transitive closure of the edges (between committed txns) having
+// a type in edge_types. skip_rw_only: do not use the edges that are exactly READ_WRITE
+void dependency_analyzer::build_txn_reach(depend_mask edge_types, bool skip_rw_only)
+{
+    auto word_num = dependency_graph.word_num;
+    txn_reach.assign((size_t)tid_num * word_num, 0);
+    for (int i = 0; i < tid_num; i++) {
+        if (f_txn_status[i] != TXN_COMMIT)
+            continue;
+        auto reach_i = &txn_reach[(size_t)i * word_num];
+        for (int dt = 0; dt < DEPEND_TYPE_NUM; dt++) {
+            if ((edge_types & DEPEND_BIT(dt)) == 0)
                 continue;
-            
-            bool has_indegree = false;
-            for (int j = 0; j < length; j++) {
-                if (direct_graph[j][i] > 0) {
-                    has_indegree = true;
-                    break;
-                }
-            }
-            if (has_indegree == false) {
-                zero_indegree_idx = i;
-                break;
-            }
+            auto row = dependency_graph.row(dt, i);
+            for (int w = 0; w < word_num; w++)
+                reach_i[w] |= row[w];
+        }
+        for (int w = 0; w < word_num; w++)
+            reach_i[w] &= committed_txn[w];
+        if (skip_rw_only == false)
+            continue;
+        for (int j = 0; j < tid_num; j++) {
+            if (dependency_graph.get(i, j) == DEPEND_BIT(READ_WRITE))
+                reach_i[j / BITSET_WORD_BITS] &= ~(1ULL << (j % BITSET_WORD_BITS));
         }
-        // if all nodes have indegree, there is a cycle
-        if (zero_indegree_idx == -1)
-            return true;
-
-        // delete the node and edge from node to other node
-        deleted_nodes.insert(zero_indegree_idx);
-        for (int j = 0; j < length; j++)
-            direct_graph[zero_indegree_idx][j] = 0; 
     }
 
-    return false;
+    // Warshall, one row is or-ed word by word
+    for (int k = 0; k < tid_num; k++) {
+        auto reach_k = &txn_reach[(size_t)k * word_num];
+        for (int i = 0; i < tid_num; i++) {
+            if (!txn_reachable(i, k))
+                continue;
+            auto reach_i = &txn_reach[(size_t)i * word_num];
+            for (int w = 0; w < word_num; w++)
+                reach_i[w] |= reach_k[w];
+        }
+    }
 }
 
-// recursively remove the node have 0 out-degree
-// return false if graph is empty after reduction, otherwise true
-bool dependency_analyzer::reduce_graph_outdegree(int **direct_graph, int length)
+// an out-edge of find_cycle_in: the target node, with or without the edge types
+static int edge_node(int edge) { return edge; }
+static int edge_node(const pair<int, depend_mask>& edge) { return edge.first; }
+static depend_mask edge_types(int) { return 0; }
+static depend_mask edge_types(const pair<int, depend_mask>& edge) { return edge.second; }
+
+template<typename edge_t>
+static void find_cycle_in(vector<vector<edge_t>>& out_edges, graph_cycle_info& info)
 {
-    set<int> deleted_nodes;
-    while (1) {
-        // check whether the graph is empty
-        if (deleted_nodes.size() == length)
-            return false;
-        
-        // find a node whose out-degree is 0
-        int zero_outdegree_idx = -1;
-        for (int i = 0; i < length; i++) {
-            if (deleted_nodes.count(i) > 0)
+    int node_num = out_edges.size();
+    info.cycle_sccs.clear();
+    info.witness.clear();
+    info.witness_types.clear();
+    info.sorted_nodes.clear();
+
+    // iterative Tarjan, the SCCs are popped in reverse topological order
+    vector<int> dfs_idx(node_num, -1), low_idx(node_num, 0), scc_id(node_num, -1);
+    vector<int> scc_stack;
+    vector<pair<int, int>> call_stack; // node, next out-edge to visit
+    // the members of the i-th SCC are scc_members[scc_end[i - 1], scc_end[i]), the last one is the root
+    vector<int> scc_members, scc_end;
+    int counter = 0;
+    for (int start = 0; start < node_num; start++) {
+        if (dfs_idx[start] != -1)
+            continue;
+        dfs_idx[start] = low_idx[start] = counter++;
+        scc_stack.push_back(start);
+        call_stack.push_back(make_pair(start, 0));
+        while (!call_stack.empty()) {
+            auto node = call_stack.back().first;
+            auto edge_pos = call_stack.back().second;
+            if (edge_pos < out_edges[node].size()) {
+                call_stack.back().second++;
+                auto next = edge_node(out_edges[node][edge_pos]);
+                if (dfs_idx[next] == -1) {
+                    dfs_idx[next] = low_idx[next] = counter++;
+                    scc_stack.push_back(next);
+                    call_stack.push_back(make_pair(next, 0));
+                } else if (scc_id[next] == -1) { // still in scc_stack
+                    low_idx[node] = min(low_idx[node], dfs_idx[next]);
+                }
                 continue;
-            
-            bool has_outdegree = false;
-            for (int j = 0; j < length; j++) {
-                if (direct_graph[i][j] > 0) {
-                    has_outdegree = true;
+            }
+            call_stack.pop_back();
+            if (!call_stack.empty()) {
+                auto dad = call_stack.back().first;
+                low_idx[dad] = min(low_idx[dad], low_idx[node]);
+            }
+            if (low_idx[node] != dfs_idx[node])
+                continue;
+            int member;
+            do {
+                member = scc_stack.back();
+                scc_stack.pop_back();
+                scc_id[member] = scc_end.size();
+                scc_members.push_back(member);
+            } while (member != node);
+            scc_end.push_back(scc_members.size());
+        }
+    }
+
+    vector<int> bfs_dist(node_num, -1), bfs_dad(node_num, -1);
+    vector<depend_mask> bfs_dad_types(node_num, 0);
+    for (int i = scc_end.size() - 1; i >= 0; i--) {
+        auto scc_begin = scc_members.begin() + (i == 0 ? 0 : scc_end[i - 1]);
+        auto scc_finish = scc_members.begin() + scc_end[i];
+        auto root = *(scc_finish - 1);
+        bool is_cycle = scc_finish - scc_begin > 1;
+        for (auto& edge : out_edges[root]) {
+            if (edge_node(edge) == root)
+                is_cycle = true;
+        }
+        if (is_cycle == false) {
+            info.sorted_nodes.push_back(root);
+            continue;
+        }
+
+        // BFS inside the SCC for the shortest cycle through the root
+        vector<int> queue;
+        queue.push_back(root);
+        bfs_dist[root] = 0;
+        int last = -1;
+        depend_mask last_types = 0;
+        for (int head = 0; head < queue.size() && last == -1; head++) {
+            auto node = queue[head];
+            for (auto& edge : out_edges[node]) {
+                auto next = edge_node(edge);
+                if (next == root) {
+                    last = node;
+                    last_types = edge_types(edge);
                     break;
                 }
+                if (scc_id[next] != i || bfs_dist[next] != -1)
+                    continue;
+                bfs_dist[next] = bfs_dist[node] + 1;
+                bfs_dad[next] = node;
+                bfs_dad_types[next] = edge_types(edge);
+                queue.push_back(next);
             }
-            if (has_outdegree == false) {
-                zero_outdegree_idx = i;
-                break;
+        }
+        if (info.witness.empty() || bfs_dist[last] + 1 < info.witness.size()) {
+            info.witness.clear();
+            info.witness_types.clear();
+            info.witness.push_back(last);
+            info.witness_types.push_back(last_types);
+            for (auto node = last; node != root; node = bfs_dad[node]) {
+                info.witness.push_back(bfs_dad[node]);
+                info.witness_types.push_back(bfs_dad_types[node]);
             }
+            reverse(info.witness.begin(), info.witness.end());
+            reverse(info.witness_types.begin(), info.witness_types.end());
         }
-        // if all nodes have outdegree, there is a cycle
-        if (zero_outdegree_idx == -1)
-            return true;
+        for (auto node : queue)
+            bfs_dist[node] = -1;
 
-        // delete the node and edge from other node to this node
-        deleted_nodes.insert(zero_outdegree_idx);
-        for (int i = 0; i < length; i++) 
-            direct_graph[i][zero_outdegree_idx] = 0;
+        vector<int> scc(scc_begin, scc_finish);
+        sort(scc.begin(), scc.end());
+        info.cycle_sccs.push_back(scc);
     }
+}
 
-    return false;
+void find_graph_cycle(depend_adj_list& out_edges, graph_cycle_info& info)
+{
+    find_cycle_in(out_edges, info);
 }
 
-bool dependency_analyzer::check_G1c()
+void find_graph_cycle(vector<vector<int>>& out_nodes, graph_cycle_info& info)
 {
-    set<dependency_type> ww_wr_set;
-    ww_wr_set.insert(WRITE_WRITE);
-    ww_wr_set.insert(WRITE_READ);
+    find_cycle_in(out_nodes, info);
+}
 
-    auto tmp_dgraph = new int* [tid_num];
-    for (int i = 0; i < tid_num; i++) 
-        tmp_dgraph[i] = new int [tid_num];
-    for (int i = 0; i < tid_num; i++) {
-        for (int j = 0; j < tid_num; j++) {
-            tmp_dgraph[i][j] = 0;
-        }
-    }
-    
-    // initialize tmp_dgraph
+void dependency_analyzer::find_txn_cycle(depend_mask edge_types, graph_cycle_info& info, bool skip_init_txn)
+{
+    auto init_txn = skip_init_txn ? tid_num - 1 : -1;
+    auto word_num = dependency_graph.word_num;
+    vector<uint64_t> row(word_num);
+    depend_adj_list out_edges(tid_num);
     for (int i = 0; i < tid_num; i++) {
-        if (f_txn_status[i] != TXN_COMMIT)
+        if (i == init_txn || f_txn_status[i] != TXN_COMMIT)
             continue;
-        for (int j = 0; j < tid_num; j++) {
-            if (f_txn_status[j] != TXN_COMMIT)
+        fill(row.begin(), row.end(), 0);
+        for (int dt = 0; dt < DEPEND_TYPE_NUM; dt++) {
+            if ((edge_types & DEPEND_BIT(dt)) == 0)
                 continue;
-            set<dependency_type> res;
-            set_intersection(ww_wr_set.begin(), ww_wr_set.end(), 
-                    dependency_graph[i][j].begin(), dependency_graph[i][j].end(),
-                    inserter(res, res.begin()));
-            
-            // have needed edges
-            if (res.empty() == false)
-                tmp_dgraph[i][j] = 1;
+            auto dt_row = dependency_graph.row(dt, i);
+            for (int w = 0; w < word_num; w++)
+                row[w] |= dt_row[w];
         }
-    }
-
-    reduce_graph_indegree(tmp_dgraph, tid_num);
-    bool have_cycle = reduce_graph_outdegree(tmp_dgraph, tid_num);
-    if (have_cycle) {
-        cerr << "have cycle in G1c" << endl;
-        for (int i = 0; i < tid_num; i++) {
-            for (int j = 0; j < tid_num; j++) {
-                if (tmp_dgraph[i][j] == 1)
-                    cerr << i << " " << j << endl;
+        for (int w = 0; w < word_num; w++) {
+            auto bits = row[w] & committed_txn[w];
+            while (bits != 0) {
+                int j = w * BITSET_WORD_BITS + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                if (j == init_txn)
+                    continue;
+                out_edges[i].push_back(make_pair(j, dependency_graph.get(i, j) & edge_types));
             }
         }
     }
-    
-    for (int i = 0; i < tid_num; i++)
-        delete[] tmp_dgraph[i];
-    delete[] tmp_dgraph;
+    find_graph_cycle(out_edges, info);
 
-    return have_cycle;
+    // the skipped txns are neither in a cycle nor sorted
+    auto& sorted_nodes = info.sorted_nodes;
+    for (int k = 0; k < sorted_nodes.size(); k++) {
+        auto txn_id = sorted_nodes[k];
+        if (txn_id != init_txn && f_txn_status[txn_id] == TXN_COMMIT)
+            continue;
+        sorted_nodes.erase(sorted_nodes.begin() + k);
+        k--;
+    }
 }
 
-// G2-item: Item Anti-dependency Cycles. A history H exhibits phenomenon G2-item
-// if DSG(H) contains a directed cycle having one or more item-anti-dependency edges.
-bool dependency_analyzer::check_G2_item()
+void dependency_analyzer::find_stmt_cycle(depend_mask edge_types, graph_cycle_info& info)
 {
-    set<dependency_type> ww_wr_rw_set;
-    ww_wr_rw_set.insert(WRITE_WRITE);
-    ww_wr_rw_set.insert(WRITE_READ);
-    ww_wr_rw_set.insert(READ_WRITE);
+    vector<bool> live(stmt_num);
+    for (int i = 0; i < stmt_num; i++)
+        live[i] = !stmt_deleted[i];
+    vector<int> first_live_from, out_nodes;
+    get_first_live_from(live, first_live_from);
+    depend_adj_list out_edges(stmt_num);
+    for (int i = 0; i < stmt_num; i++) {
+        if (!live[i])
+            continue;
+        stmt_out_nodes(i, edge_types, first_live_from, out_nodes);
+        for (auto j : out_nodes)
+            out_edges[i].push_back(make_pair(j, get_stmt_depend(i, j) & edge_types));
+    }
+    find_graph_cycle(out_edges, info);
+}
 
-    auto tmp_dgraph = new int* [tid_num];
-    for (int i = 0; i < tid_num; i++) 
-        tmp_dgraph[i] = new int [tid_num];
-    for (int i = 0; i < tid_num; i++) {
-        for (int j = 0; j < tid_num; j++) {
-            tmp_dgraph[i][j] = 0;
+void dependency_analyzer::print_cycle_witness(graph_cycle_info& info, bool is_stmt_graph)
+{
+    *report << "cycle SCC num: " << info.cycle_sccs.size() << ", witness cycle: ";
+    for (int i = 0; i < info.witness.size(); i++) {
+        if (is_stmt_graph) {
+            auto sid = get_stmt_id(info.witness[i]);
+            *report << sid.txn_id << "." << sid.stmt_idx_in_txn;
+        } else {
+            *report << info.witness[i];
         }
-    }
-    
-    // initialize tmp_dgraph
-    for (int i = 0; i < tid_num; i++) {
-        if (f_txn_status[i] != TXN_COMMIT)
-            continue;
-        for (int j = 0; j < tid_num; j++) {
-            if (f_txn_status[j] != TXN_COMMIT)
-                continue;
-            set<dependency_type> res;
-            set_intersection(ww_wr_rw_set.begin(), ww_wr_rw_set.end(), 
-                    dependency_graph[i][j].begin(), dependency_graph[i][j].end(),
-                    inserter(res, res.begin()));
-            
-            // have needed edges
-            if (res.empty() == false)
-                tmp_dgraph[i][j] = 1;
+        *report << " -(";
+        for (int dt = 0; dt < DEPEND_TYPE_NUM; dt++) {
+            if (info.witness_types[i] & DEPEND_BIT(dt))
+                *report << dt << " ";
+        }
+        *report << ")-> ";
+    }
+    if (!info.witness.empty()) {
+        if (is_stmt_graph) {
+            auto sid = get_stmt_id(info.witness[0]);
+            *report << sid.txn_id << "." << sid.stmt_idx_in_txn;
+        } else {
+            *report << info.witness[0];
         }
     }
+    *report << endl;
+}
 
-    reduce_graph_indegree(tmp_dgraph, tid_num);
-    bool have_cycle = reduce_graph_outdegree(tmp_dgraph, tid_num);
-    if (have_cycle) {
-        cerr << "have cycle in G2_item" << endl;
-        for (int i = 0; i < tid_num; i++) {
-            for (int j = 0; j < tid_num; j++) {
-                if (tmp_dgraph[i][j] == 1) {
-                    cerr << i << " " << j << ": ";
-                    for (auto& dependency:dependency_graph[i][j])
-                        cerr << dependency << " ";
-                    cerr << endl;
-                }
-            }
-        }
+bool dependency_analyzer::check_G1()
+{
+    if (check_G1a()) {
+        *report << "G1a found" << endl;
+        violated_check = "G1a";
+        return true;
     }
-    
-    for (int i = 0; i < tid_num; i++)
-        delete[] tmp_dgraph[i];
-    delete[] tmp_dgraph;
+    if (check_G1b()) {
+        *report << "G1b found" << endl;
+        violated_check = "G1b";
+        return true;
+    }
+    if (check_G1c()) {
+        violated_check = "G1c";
+        return true;
+    }
+    return false;
+}
 
-    return have_cycle;
+bool dependency_analyzer::check_G1c()
+{
+    graph_cycle_info info;
+    find_txn_cycle(DEPEND_BIT(WRITE_WRITE) | DEPEND_BIT(WRITE_READ), info);
+    if (!info.has_cycle())
+        return false;
+    *report << "have cycle in G1c" << endl;
+    print_cycle_witness(info, false);
+    return true;
+}
+
+// G2-item: Item Anti-dependency Cycles. A history H exhibits phenomenon G2-item
+// if DSG(H) contains a directed cycle having one or more item-anti-dependency edges.
+bool dependency_analyzer::check_G2_item()
+{
+    graph_cycle_info info;
+    find_txn_cycle(DEPEND_BIT(WRITE_WRITE) | DEPEND_BIT(WRITE_READ) | DEPEND_BIT(READ_WRITE), info);
+    if (!info.has_cycle())
+        return false;
+    *report << "have cycle in G2_item" << endl;
+    print_cycle_witness(info, false);
+    return true;
 }
 
 bool dependency_analyzer::check_GSIa()
 {
+    auto word_num = dependency_graph.word_num;
     for (int i = 0; i < tid_num; i++) {
-        for (int j = 0; j < tid_num; j++) {
-            // check whether they have ww or wr dependency
-            if (dependency_graph[i][j].count(WRITE_WRITE) == 0 &&
-                    dependency_graph[i][j].count(WRITE_READ) == 0) 
+        if (f_txn_status[i] != TXN_COMMIT)
+            continue;
+        auto ww_row = dependency_graph.row(WRITE_WRITE, i);
+        auto wr_row = dependency_graph.row(WRITE_READ, i);
+        auto start_row = dependency_graph.row(START_DEPEND, i);
+        for (int w = 0; w < word_num; w++) {
+            // ww or wr dependency without start dependency
+            auto bits = (ww_row[w] | wr_row[w]) & ~start_row[w] & committed_txn[w];
+            if (bits == 0)
                 continue;
-            
-            // check whether they have start dependency
-            if (dependency_graph[i][j].count(START_DEPEND) == 0) {
-                cerr << "txn i: " << i <<endl;
-                cerr << "txn j: " << j << endl;
-                return true;
-            }
-                
+            *report << "txn i: " << i <<endl;
+            *report << "txn j: " << w * BITSET_WORD_BITS + __builtin_ctzll(bits) << endl;
+            return true;
         }
     }
     return false;
@@ -1077,259 +1502,283 @@ bool dependency_analyzer::check_GSIa()
 
 bool dependency_analyzer::check_GSIb()
 {
-    set<dependency_type> target_dependency_set;
-    target_dependency_set.insert(WRITE_WRITE);
-    target_dependency_set.insert(WRITE_READ);
-    target_dependency_set.insert(READ_WRITE);
-    target_dependency_set.insert(STRICT_START_DEPEND);
-    
-    auto tmp_dgraph = new int* [tid_num];
-    for (int i = 0; i < tid_num; i++) 
-        tmp_dgraph[i] = new int [tid_num];
-    for (int i = 0; i < tid_num; i++) {
-        for (int j = 0; j < tid_num; j++) {
-            tmp_dgraph[i][j] = 0;
-        }
-    }
+    // the edges that are exactly READ_WRITE are the anti-dependency ones, 
+    // other edges (WR, WW, START(equal to WR or WW according to GSIa)) are not
+    build_txn_reach(DEPEND_BIT(WRITE_WRITE) | DEPEND_BIT(WRITE_READ) | 
+                    DEPEND_BIT(READ_WRITE) | DEPEND_BIT(STRICT_START_DEPEND), true);
     
-    // initialize tmp_dgraph
+    // a cycle with exactly one rw edge i -> j: j reaches i without rw edges
     for (int i = 0; i < tid_num; i++) {
         if (f_txn_status[i] != TXN_COMMIT)
             continue;
         for (int j = 0; j < tid_num; j++) {
-            if (f_txn_status[j] != TXN_COMMIT)
+            if (i == j || f_txn_status[j] != TXN_COMMIT)
                 continue;
-            set<dependency_type> res;
-            set_intersection(target_dependency_set.begin(), target_dependency_set.end(), 
-                    dependency_graph[i][j].begin(), dependency_graph[i][j].end(),
-                    inserter(res, res.begin()));
-            
-            // have needed edges
-            if (res.empty() == false)
-                tmp_dgraph[i][j] = 1;
-        }
-    }
-
-    if (reduce_graph_indegree(tmp_dgraph, tid_num) == false ||
-            reduce_graph_outdegree(tmp_dgraph, tid_num) == false) {// empty
-        
-        for (int i = 0; i < tid_num; i++)
-            delete[] tmp_dgraph[i];
-        delete[] tmp_dgraph;
-        return false;
-    }
-    
-    // check which edge only have rw dependency
-    vector<pair<int, int>> rw_edges;
-    for (int i = 0; i < tid_num; i++) {
-        for (int j = 0; j < tid_num; j++) {
-            if (tmp_dgraph[i][j] == 0)
+            if (dependency_graph.get(i, j) != DEPEND_BIT(READ_WRITE))
                 continue;
-            // if there is other depend (WR, WW, START(equal to WR or WW according to GSIa)), 
-            // no need to remove it, will be report by G1c
-            if (dependency_graph[i][j].size() > 1)
-                continue;
-            if (dependency_graph[i][j].count(READ_WRITE) == 0)
+            if (!txn_reachable(j, i))
                 continue;
             
-            // exactly the READ_WRITE depend
-            rw_edges.push_back(pair<int, int>(i, j));
-            tmp_dgraph[i][j] = 0; // delete the edge
+            *report << "have cycle in GSIb" << endl;
+            *report << "rw edge: " << i << " " << j << endl;
+            for (int k = 0; k < tid_num; k++) {
+                if (k == i || !txn_reachable(j, k) || !txn_reachable(k, i))
+                    continue;
+                *report << "txn in the cycle: " << k << endl;
+            }
+            return true;
         }
     }
-    
-    // only leave one rw edege
-    bool has_rw_cycle = false;
-    for (auto& rw_edge : rw_edges) {
-        // only insert 1 rw edge each time
-        tmp_dgraph[rw_edge.first][rw_edge.second] = 1;
-        if (reduce_graph_indegree(tmp_dgraph, tid_num)) {
-            has_rw_cycle = true;
-            break;
+    return false;
+}
+
+bool dependency_analyzer::check_isolation(isolation_level level)
+{
+    struct isolation_check {
+        string name;
+        bool (dependency_analyzer::*check)();
+        bool is_proscribed; // by level, the others are only recorded in allowed_anomalies
+    };
+    // cheap ones first, G-SIb needs a transitive closure
+    vector<isolation_check> checks;
+    checks.push_back({"G1", &dependency_analyzer::check_G1, true});
+    checks.push_back({"GSIa", &dependency_analyzer::check_GSIa, level == PL_SI});
+    checks.push_back({"G2_item", &dependency_analyzer::check_G2_item, level == PL_2_99 || level == PL_3});
+    checks.push_back({"GSIb", &dependency_analyzer::check_GSIb, level == PL_SI});
+
+    violated_check.clear();
+    allowed_anomalies.clear();
+    for (auto& c : checks) {
+        if (!(this->*c.check)())
+            continue;
+        if (!c.is_proscribed) {
+            allowed_anomalies.push_back(c.name);
+            continue;
         }
-        tmp_dgraph[rw_edge.first][rw_edge.second] = 0;
+        *report << "check_" << c.name << " violate!!" << endl;
+        if (violated_check.empty())
+            violated_check = c.name;
+        return true;
     }
+    return false;
+}
 
-    if (has_rw_cycle) {
-        cerr << "have cycle in GSIb" << endl;
-        for (int i = 0; i < tid_num; i++) {
-            for (int j = 0; j < tid_num; j++) {
-                if (tmp_dgraph[i][j] == 1) {
-                    cerr << i << " " << j << ": ";
-                    for (auto& dependency:dependency_graph[i][j])
-                        cerr << dependency << " ";
-                    cerr << endl;
-                }
+void dependency_analyzer::get_strict_start_edges(vector<pair<int, int>>& edges)
+{
+    edges.clear();
+    for (int tid = 0; tid < tid_num; tid++) {
+        auto& from = txn_stmt_queue_idx[tid];
+        for (int later_tid = 0; later_tid < tid_num; later_tid++) {
+            if ((dependency_graph.get(tid, later_tid) & DEPEND_BIT(STRICT_START_DEPEND)) == 0)
+                continue;
+            auto& to = txn_stmt_queue_idx[later_tid];
+            int k = 0;
+            for (int x = 0; x < from.size(); x++) {
+                while (k < to.size() && to[k] < from[x])
+                    k++;
+                if (k == to.size())
+                    break;
+                if (x + 1 < from.size() && from[x + 1] < to[k])
+                    continue; // the next stmt reaches to[k] by the inner edge
+                edges.push_back(make_pair(from[x], to[k]));
             }
         }
     }
-
-    for (int i = 0; i < tid_num; i++)
-        delete[] tmp_dgraph[i];
-    delete[] tmp_dgraph;
-
-    return has_rw_cycle;
 }
 
-// stmt_dist_graph may have cycle
-vector<stmt_id> dependency_analyzer::longest_stmt_path(
-    map<pair<stmt_id, stmt_id>, int>& stmt_dist_graph)
+void dependency_analyzer::build_stmt_pass_graph(const vector<bool>& deleted, const vector<bool>& on_cycle,
+        const vector<pair<int, int>>& start_edges, vector<vector<int>>& graph)
 {
-    map<stmt_id, stmt_id> dad_stmt;
-    map<stmt_id, int> dist_length;
-    set<stmt_id> real_deleted_node; // to delete cycle
-    for (int i = 0; i < stmt_num; i++) {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
-        dist_length[stmt_i] = 0;
+    auto dist_types = (depend_mask)~(DEPEND_BIT(START_DEPEND) | DEPEND_BIT(INSTRUMENT_DEPEND));
+    // the node of stmt j reached by a strict start edge
+    auto start_node = [&](int j) { return deleted[j] ? stmt_num + j : j; };
+    graph.resize(2 * stmt_num);
+    for (auto& out_nodes : graph)
+        out_nodes.clear();
+    for (auto& stmt_queue_idx : txn_stmt_queue_idx) {
+        for (int k = 0; k + 1 < stmt_queue_idx.size(); k++) {
+            auto i = stmt_queue_idx[k], next = stmt_queue_idx[k + 1];
+            if (on_cycle[i] && on_cycle[next])
+                graph[i].push_back(next);
+            if (deleted[i] && on_cycle[stmt_num + i] && on_cycle[start_node(next)])
+                graph[stmt_num + i].push_back(start_node(next));
+        }
+    }
+    for (auto& edge : start_edges) {
+        if (on_cycle[edge.first] && on_cycle[start_node(edge.second)])
+            graph[edge.first].push_back(start_node(edge.second));
     }
-    set<stmt_id> all_stmt_set;
     for (int i = 0; i < stmt_num; i++) {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
-        all_stmt_set.insert(stmt_i);
+        if (deleted[i] || !on_cycle[i])
+            continue;
+        for (auto& branch : stmt_dependency_graph.sparse_rows[i]) {
+            auto j = branch.first;
+            if (!deleted[j] && on_cycle[j] && (branch.second & dist_types) != 0)
+                graph[i].push_back(j);
+        }
     }
+}
 
-    auto tmp_stmt_graph = stmt_dist_graph;
-    set<stmt_id> delete_node;
-    while (delete_node.size() + real_deleted_node.size() < stmt_num) {
-        int zero_indegree_idx = -1;
-        // --- find zero-indegree statement ---
-        for (int i = 0; i < stmt_num; i++) {
-            auto stmt_i = stmt_id(f_txn_id_queue, i);
-            if (delete_node.count(stmt_i) > 0) // has been deleted from tmp_stmt_graph
-                continue;
-            if (real_deleted_node.count(stmt_i) > 0) // // has been really deleted (for decycle)
-                continue;
-            bool has_indegree = false;
-            for (int j = 0; j < stmt_num; j++) {
-                auto stmt_j = stmt_id(f_txn_id_queue, j);
-                if (tmp_stmt_graph.count(make_pair(stmt_j, stmt_i)) > 0) {
-                    has_indegree = true;
-                    break;
-                }
-            }
-            if (has_indegree == false) {
-                zero_indegree_idx = i;
-                break;
-            }
+bool dependency_analyzer::delete_cycle_groups(vector<vector<int>>& graph, vector<bool>& deleted, vector<bool>& on_cycle, int batch_div)
+{
+    graph_cycle_info cycle_info;
+    find_graph_cycle(graph, cycle_info);
+    on_cycle.assign(graph.size(), false);
+    if (!cycle_info.has_cycle())
+        return false;
+    for (auto& scc : cycle_info.cycle_sccs) {
+        vector<int> live_nodes;
+        for (auto node : scc) {
+            if (node < stmt_num && !deleted[node])
+                live_nodes.push_back(node);
         }
-        // ------------------------------------
-        
-        // if do not has zero-indegree statement, so there is a cycle
-        if (zero_indegree_idx == -1) {
-            // cerr << "There is a cycle in longest_stmt_path(), delete one node: ";
-            // select one node to delete
-            auto tmp_stmt_set = all_stmt_set;
-            for (auto& node : delete_node) 
-                tmp_stmt_set.erase(node);
-            for (auto& node : real_deleted_node)
-                tmp_stmt_set.erase(node);
-            auto r = rand() % tmp_stmt_set.size();
-            auto select_one_it = tmp_stmt_set.begin();
-            advance(select_one_it, r);
-
-            // delete its set (version_set, before_read, itself, after_read)
-            auto select_stmt_id = *select_one_it;
-            auto select_queue_idx = select_stmt_id.transfer_2_stmt_idx(f_txn_id_queue);
-            auto select_idx_set = get_instrumented_stmt_set(select_queue_idx);
-            for (auto chosen_idx : select_idx_set) {
-                auto chosen_stmt_id = stmt_id(f_txn_id_queue, chosen_idx);
-                real_deleted_node.insert(chosen_stmt_id);
-                for (int i = 0; i < stmt_num; i++) {
-                    auto out_branch = make_pair(chosen_stmt_id, stmt_id(f_txn_id_queue, i));
-                    auto in_branch = make_pair(stmt_id(f_txn_id_queue, i), chosen_stmt_id);
-                    tmp_stmt_graph.erase(out_branch);
-                    tmp_stmt_graph.erase(in_branch);
-                }
-                // cerr << chosen_stmt_id.txn_id << "." << chosen_stmt_id.stmt_idx_in_txn << ", ";
-            }
-            // cerr << endl;
+        if (live_nodes.empty()) // broken by the group deleted for another SCC
             continue;
+        int select_num = batch_div == 0 ? 1 : max(1, (int)live_nodes.size() / batch_div);
+        for (int k = 0; k < select_num; k++) {
+            auto select_node = live_nodes[rand() % live_nodes.size()];
+            if (deleted[select_node]) // its group is selected in this round
+                continue;
+            auto select_group = instrument_group_of[select_node];
+            for (auto chosen_it = group_begin(select_group); chosen_it != group_end(select_group); chosen_it++)
+                deleted[*chosen_it] = true;
         }
-        // ------------------------------------
-        
-        // if do has zero-indegree statement
-        int cur_max_length = 0;
-        stmt_id cur_max_dad;
-        auto stmt_zero_idx = stmt_id(f_txn_id_queue, zero_indegree_idx);
+    }
+    for (auto& scc : cycle_info.cycle_sccs) {
+        for (auto node : scc)
+            on_cycle[node] = true;
+    }
+    return true;
+}
+
+// stmt_dist_graph[i] is the weighted out-edges of the i-th stmt, it may have cycle
+vector<stmt_id> dependency_analyzer::longest_stmt_path(stmt_dist_list& stmt_dist_graph)
+{
+    // decycle: delete the instrumentation group of one random stmt in each 
+    // cycle SCC, until the remaining graph is acyclic
+    vector<bool> real_deleted_node(stmt_num, false);
+    vector<bool> on_cycle;
+    vector<vector<int>> live_graph; // the edges between the live stmts, without distance
+    while (true) {
+        live_graph.assign(stmt_num, vector<int>());
         for (int i = 0; i < stmt_num; i++) {
-            auto stmt_i = stmt_id(f_txn_id_queue, i);
-            if (real_deleted_node.count(stmt_i) > 0) // // has been really deleted (for decycle)
+            if (real_deleted_node[i])
                 continue;
-            auto branch = make_pair(stmt_i, stmt_zero_idx);
-            if (stmt_dist_graph.count(branch) == 0)
-                continue;
-            if (dist_length[stmt_i] + stmt_dist_graph[branch] > cur_max_length) {
-                cur_max_length = dist_length[stmt_i] + stmt_dist_graph[branch];
-                cur_max_dad = stmt_i;
+            for (auto& branch : stmt_dist_graph[i]) {
+                if (real_deleted_node[branch.first])
+                    continue;
+                live_graph[i].push_back(branch.first);
             }
         }
-        dist_length[stmt_zero_idx] = cur_max_length;
-        dad_stmt[stmt_zero_idx] = cur_max_dad; // the first one is (-1, -1): no dad
+        if (!delete_cycle_groups(live_graph, real_deleted_node, on_cycle))
+            break;
+    }
+
+    // in-edges sorted by the source, so that the earliest dad wins the tie
+    vector<vector<pair<int, int>>> in_edges(stmt_num);
+    for (int i = 0; i < stmt_num; i++) {
+        if (real_deleted_node[i])
+            continue;
+        for (auto& branch : stmt_dist_graph[i]) {
+            if (real_deleted_node[branch.first])
+                continue;
+            in_edges[branch.first].push_back(make_pair(i, branch.second));
+        }
+    }
 
-        delete_node.insert(stmt_zero_idx);
-        for (int j = 0; j < stmt_num; j++) {
-            auto branch = make_pair(stmt_zero_idx, stmt_id(f_txn_id_queue, j));
-            tmp_stmt_graph.erase(branch);
+    // one Kahn pass over the live graph, the dist of a stmt is settled when it is popped
+    vector<int> indegree(stmt_num, 0);
+    vector<int> ready_nodes;
+    for (int i = 0; i < stmt_num; i++) {
+        indegree[i] = in_edges[i].size();
+        if (!real_deleted_node[i] && indegree[i] == 0)
+            ready_nodes.push_back(i);
+    }
+    vector<int> dist_length(stmt_num, 0);
+    vector<int> dad_stmt(stmt_num, -1); // -1: no dad
+    for (int k = 0; k < ready_nodes.size(); k++) {
+        auto node = ready_nodes[k];
+        for (auto& branch : in_edges[node]) {
+            if (dist_length[branch.first] + branch.second > dist_length[node]) {
+                dist_length[node] = dist_length[branch.first] + branch.second;
+                dad_stmt[node] = branch.first;
+            }
+        }
+        for (auto next : live_graph[node]) {
+            if (--indegree[next] == 0)
+                ready_nodes.push_back(next);
         }
     }
 
     vector<stmt_id> longest_path;
     int longest_dist = 0;
-    stmt_id longest_dist_stmt;
+    int longest_dist_stmt = -1;
     for (int i = 0; i < stmt_num; i++) {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
-        if (real_deleted_node.count(stmt_i) > 0) // // has been really deleted (for decycle)
-                continue;
-        auto path_length = dist_length[stmt_i];
-        if (path_length > longest_dist) {
-            longest_dist = path_length;
-            longest_dist_stmt = stmt_i;
+        if (real_deleted_node[i])
+            continue;
+        if (dist_length[i] > longest_dist) {
+            longest_dist = dist_length[i];
+            longest_dist_stmt = i;
         }
     }
 
-    while (longest_dist_stmt.txn_id != -1) { // default
-        longest_path.insert(longest_path.begin(), longest_dist_stmt);
-        longest_dist_stmt = dad_stmt[longest_dist_stmt];
-    }
+    for (auto i = longest_dist_stmt; i != -1; i = dad_stmt[i])
+        longest_path.push_back(get_stmt_id(i));
+    reverse(longest_path.begin(), longest_path.end());
 
-    cerr << "stmt path length: " << longest_dist << endl;
+    *report << "stmt path length: " << longest_dist << endl;
     return longest_path;
 }
 
-vector<stmt_id> dependency_analyzer::longest_stmt_path()
+void dependency_analyzer::build_stmt_dist_graph(const vector<bool>& live, stmt_dist_list& stmt_dist_graph)
 {
-    map<pair<stmt_id, stmt_id>, int> stmt_dist_graph;
+    auto edge_types = (depend_mask)~(DEPEND_BIT(START_DEPEND) | DEPEND_BIT(INSTRUMENT_DEPEND));
+    vector<int> first_live_from, out_nodes;
+    get_first_live_from(live, first_live_from);
+    stmt_dist_graph.assign(stmt_num, vector<pair<int, int>>());
     for (int i = 0; i < stmt_num; i++) {
-        if (f_txn_status[f_txn_id_queue[i]] != TXN_COMMIT)
+        if (!live[i])
             continue;
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
-        for (int j = 0; j < stmt_num; j++) {
-            if (f_txn_status[f_txn_id_queue[j]] != TXN_COMMIT)
-                continue;
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
-            auto branch = make_pair(stmt_i, stmt_j);
-            if (stmt_dependency_graph.count(branch) == 0)
+        stmt_out_nodes(i, edge_types, first_live_from, out_nodes);
+        for (auto j : out_nodes) {
+            auto depend_set = get_stmt_depend(i, j) & edge_types;
+            if (depend_set == 0)
                 continue;
-            auto depend_set = stmt_dependency_graph[branch];
-            depend_set.erase(START_DEPEND);
-            depend_set.erase(INSTRUMENT_DEPEND);
-            if (depend_set.empty()) 
-                continue;
-            if (depend_set.count(INNER_DEPEND) > 0 && depend_set.size() == 1)
-                stmt_dist_graph[branch] = 1;
-            else if (depend_set.count(STRICT_START_DEPEND) > 0 && depend_set.size() == 1)
-                stmt_dist_graph[branch] = 10;
-            else if (depend_set.count(STRICT_START_DEPEND) > 0 || depend_set.count(INNER_DEPEND) > 0)
-                stmt_dist_graph[branch] = 100; // contain STRICT_START_DEPEND or INNER_DEPEND, and other
-            else if (depend_set.count(WRITE_WRITE) > 0 || 
-                     depend_set.count(WRITE_READ) > 0)
-                stmt_dist_graph[branch] = 100000; // contain WRITE_READ or WRITE_WRITE, but do not contain start and inner
-            else if (depend_set.count(VERSION_SET_DEPEND) > 0 || 
-                     depend_set.count(OVERWRITE_DEPEND) > 0 ||
-                     depend_set.count(READ_WRITE) > 0)
-                stmt_dist_graph[branch] = 10000; // only contain VERSION_SET_DEPEND, OVERWRITE_DEPEND and READ_WRITE
+            if (depend_set == DEPEND_BIT(INNER_DEPEND))
+                stmt_dist_graph[i].push_back(make_pair(j, 1));
+            else if (depend_set == DEPEND_BIT(STRICT_START_DEPEND))
+                stmt_dist_graph[i].push_back(make_pair(j, 10));
+            else if (depend_set & (DEPEND_BIT(STRICT_START_DEPEND) | DEPEND_BIT(INNER_DEPEND)))
+                stmt_dist_graph[i].push_back(make_pair(j, 100)); // contain STRICT_START_DEPEND or INNER_DEPEND, and other
+            else if (depend_set & (DEPEND_BIT(WRITE_WRITE) | DEPEND_BIT(WRITE_READ)))
+                stmt_dist_graph[i].push_back(make_pair(j, 100000)); // contain WRITE_READ or WRITE_WRITE, but do not contain start and inner
+            else if (depend_set & (DEPEND_BIT(VERSION_SET_DEPEND) | DEPEND_BIT(OVERWRITE_DEPEND) | DEPEND_BIT(READ_WRITE)))
+                stmt_dist_graph[i].push_back(make_pair(j, 10000)); // only contain VERSION_SET_DEPEND, OVERWRITE_DEPEND and READ_WRITE
         }
     }
+}
+
+vector<stmt_id> dependency_analyzer::longest_stmt_path()
+{
+    vector<bool> live(stmt_num);
+    for (int i = 0; i < stmt_num; i++)
+        live[i] = f_txn_status[f_txn_id_queue[i]] == TXN_COMMIT && !stmt_deleted[i];
+    stmt_dist_list stmt_dist_graph;
+    if (large_history) {
+        // decycle on the graph keeping the deleted stmts, so its edges are only got once
+        vector<pair<int, int>> start_edges;
+        get_strict_start_edges(start_edges);
+        vector<bool> deleted(stmt_num), on_cycle(2 * stmt_num, true);
+        vector<vector<int>> graph;
+        for (int i = 0; i < stmt_num; i++)
+            deleted[i] = !live[i];
+        do {
+            build_stmt_pass_graph(deleted, on_cycle, start_edges, graph);
+        } while (delete_cycle_groups(graph, deleted, on_cycle, LARGE_DECYCLE_BATCH_DIV));
+        for (int i = 0; i < stmt_num; i++)
+            live[i] = !deleted[i];
+    }
+    build_stmt_dist_graph(live, stmt_dist_graph);
 
     auto path = longest_stmt_path(stmt_dist_graph);
     auto path_size = path.size();
@@ -1346,7 +1795,7 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path()
 
     // delete replaced stmt
     for (int i = 0; i < path_size; i++) {
-        auto queue_idx = path[i].transfer_2_stmt_idx(f_txn_id_queue);
+        auto queue_idx = get_queue_idx(path[i]);
         if (f_stmt_usage[queue_idx] != INIT_TYPE)
             continue;
         path.erase(path.begin() + i);
@@ -1357,273 +1806,274 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path()
     return path;
 }
 
-vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_nodes, bool* delete_flag)
+vector<stmt_id> dependency_analyzer::topological_sort_path(const set<stmt_id>& deleted_nodes, bool* delete_flag)
 {
     if (delete_flag != NULL)
         *delete_flag = false;
     vector<stmt_id> path;
-    auto tmp_stmt_dependency_graph = stmt_dependency_graph;
-    set<stmt_id> outputted_node; // the node that has been outputted from graph
-    set<stmt_id> all_stmt_set; // record all stmts in the graph 
-    for (int i = 0; i < stmt_num; i++) {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
-        all_stmt_set.insert(stmt_i);
-    }
-
-    // deleted_nodes include: 
+    // start from the kept degrees, the stmts outputted or deleted here are only 
+    // removed from the counts
+    auto in_degree = group_in_degree;
+    auto out_degree = group_out_degree;
+    auto removed = stmt_deleted;
+    auto remove_stmt = [&](int i) {
+        if (removed[i])
+            return;
+        update_group_degree(i, -1, in_degree, out_degree, removed);
+        removed[i] = true;
+    };
+
+    // deleted nodes include: 
     //  1) the nodes that have been deleted for decycle, 
     //  2) the nodes in abort stmt
     //  3) the nodes that have been deleted in transaction_test::multi_stmt_round_test
+    // the given ones that are not in this history are only counted
+    vector<bool> is_deleted(stmt_num, false);
+    vector<bool> is_outputted(stmt_num, false);
+    int deleted_num = 0, outputted_num = 0;
+    for (auto& sid : deleted_nodes) {
+        auto idx = get_queue_idx(sid);
+        if (idx != -1)
+            is_deleted[idx] = true;
+        deleted_num++;
+    }
     
     // delete node that in abort txn
     for (int i = 0; i < stmt_num; i++) {
         auto txn_id = f_txn_id_queue[i];
         if (f_txn_status[txn_id] == TXN_COMMIT)
             continue;
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
-        deleted_nodes.insert(stmt_i); 
-        for (int j = 0; j < stmt_num; j++) {
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
-            auto out_branch = make_pair(stmt_i, stmt_j);
-            auto in_branch = make_pair(stmt_j, stmt_i);
-            tmp_stmt_dependency_graph.erase(out_branch);
-            tmp_stmt_dependency_graph.erase(in_branch);
+        if (!is_deleted[i]) {
+            is_deleted[i] = true;
+            deleted_num++;
         }
+        remove_stmt(i);
     }
 
-    // delete start and inner dependency
+    // a group is outputted or deleted as a whole (version_set, before_read, itself, after_read),
+    // so its first and last alive stmt are fixed here. a group without alive stmt is never chosen
+    vector<int> first_alive(instrument_group_num, -1), last_alive(instrument_group_num, -1);
     for (int i = 0; i < stmt_num; i++) {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
-        for (int j = i; j < stmt_num; j++) {
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
-            auto out_branch = make_pair(stmt_i, stmt_j);
-            auto in_branch = make_pair(stmt_j, stmt_i);
-            if (tmp_stmt_dependency_graph.count(out_branch)) {
-                tmp_stmt_dependency_graph[out_branch].erase(START_DEPEND);
-                tmp_stmt_dependency_graph[out_branch].erase(STRICT_START_DEPEND);
-                tmp_stmt_dependency_graph[out_branch].erase(INNER_DEPEND);
-                if (tmp_stmt_dependency_graph[out_branch].empty())
-                    tmp_stmt_dependency_graph.erase(out_branch);
-            }
-            if (tmp_stmt_dependency_graph.count(in_branch)) {
-                tmp_stmt_dependency_graph[in_branch].erase(START_DEPEND);
-                tmp_stmt_dependency_graph[in_branch].erase(STRICT_START_DEPEND);
-                tmp_stmt_dependency_graph[in_branch].erase(INNER_DEPEND);
-                if (tmp_stmt_dependency_graph[in_branch].empty())
-                    tmp_stmt_dependency_graph.erase(in_branch);
+        if (is_deleted[i])
+            continue;
+        auto g = instrument_group_of[i];
+        if (first_alive[g] == -1)
+            first_alive[g] = i;
+        last_alive[g] = i;
+    }
+    vector<bool> group_done(instrument_group_num, false);
+    auto is_alive = [&](int g) { return !group_done[g] && last_alive[g] != -1; };
+
+    // ready frontier: the alive groups without in-edge, the one having the 
+    // latest stmt first (use reverse order as possible)
+    priority_queue<pair<int, int>> ready; // (last alive stmt, group)
+    vector<bool> in_ready(instrument_group_num, false);
+    auto push_if_ready = [&](int g) {
+        if (in_ready[g] || !is_alive(g) || in_degree[g] != 0)
+            return;
+        in_ready[g] = true;
+        ready.push(make_pair(last_alive[g], g));
+    };
+    for (int g = 0; g < instrument_group_num; g++)
+        push_if_ready(g);
+
+    auto retire_group = [&](int g, bool output) {
+        group_done[g] = true;
+        for (auto it = group_begin(g); it != group_end(g); it++) {
+            auto i = *it;
+            if (output) {
+                path.push_back(get_stmt_id(i));
+                is_outputted[i] = true;
+                outputted_num++;
+            } else if (!is_deleted[i]) {
+                is_deleted[i] = true;
+                deleted_num++;
             }
+            remove_stmt(i);
         }
-    }
-
-    while (outputted_node.size() + deleted_nodes.size() < stmt_num) {
-        int zero_indegree_idx = -1;
-        set<int> checked_idx;
-        // --- find zero-indegree stmt block ---
-        for (int i = stmt_num - 1; i >= 0; i--) { // use reverse order as possible
-            if (checked_idx.count(i) > 0)
-                continue;
-            auto stmt_i = stmt_id(f_txn_id_queue, i);
-            if (outputted_node.count(stmt_i) > 0) // has been outputted from tmp_stmt_graph
-                continue;
-            if (deleted_nodes.count(stmt_i) > 0) // has been really deleted (for decycle)
-                continue;
-            bool has_indegree = false;
-
-            // get its set (version_set, before_read, itself, after_read)
-            // check whether the node and its set have indegree
-            set<int> i_idx_set = get_instrumented_stmt_set(i);
-            for (auto chosen_idx : i_idx_set) {
-                checked_idx.insert(chosen_idx);
-                auto stmt_chosen_idx = stmt_id(f_txn_id_queue, chosen_idx);
-                for (int j = 0; j < stmt_num; j++) {
-                    if (i_idx_set.count(j) > 0) // exclude self ring
-                        continue;
-                    auto stmt_j = stmt_id(f_txn_id_queue, j);
-                    auto in_branch = make_pair(stmt_j, stmt_chosen_idx);
-                    if (tmp_stmt_dependency_graph.count(in_branch) == 0)
-                        continue;
-                    // if (tmp_stmt_dependency_graph[in_branch].count(INSTRUMENT_DEPEND) > 0)
-                    //     continue; // its self set edges
-                    
-                    has_indegree = true; // have other depends
-                    break;
-                }
-                if (has_indegree == true) 
-                    break;
-            }
-            if (has_indegree == false) {
-                zero_indegree_idx = i;
-                break;
-            }
+        for (auto it = group_begin(g); it != group_end(g); it++) {
+            for (auto j : stmt_dependency_graph.out_list[*it])
+                push_if_ready(instrument_group_of[j]);
+        }
+    };
+
+    // the later cycles can only be among the groups of the cycle SCCs found last time
+    vector<bool> maybe_cyclic(instrument_group_num, true);
+    vector<pair<int, depend_mask>> stmt_edges;
+    depend_adj_list group_edges(instrument_group_num);
+    while (outputted_num + deleted_num < stmt_num) {
+        if (!ready.empty()) {
+            auto g = ready.top().second;
+            ready.pop();
+            retire_group(g, true);
+            continue;
         }
-        // ------------------------------------
-        
-        // if do not has zero-indegree statement, so there is a cycle
-        // randomly select a stmt, delete it and its set
-        if (zero_indegree_idx == -1) {
-            // cerr << "There is a cycle in topological_sort_path()" << endl;
-            if (delete_flag != NULL)
-                *delete_flag = true;
-            
-            // find the node that has the most in-edges and out-edges, and delete it
-            int max_edge_num = 0;
-            int target_idx = 0;
-            set<int> checked_idx_for_delete;
-            for (int i = 0; i < stmt_num; i++) {
-                if (checked_idx_for_delete.count(i) > 0)
-                    continue;
-
-                auto stmt_i = stmt_id(f_txn_id_queue, i);
-                if (outputted_node.count(stmt_i) > 0) // has been outputted from tmp_stmt_graph
-                    continue;
-                if (deleted_nodes.count(stmt_i) > 0) // has been really deleted (for decycle)
-                    continue;
 
-                set<int> i_idx_set = get_instrumented_stmt_set(i);
-                int edge_num = 0;
-                for (auto chosen_idx : i_idx_set) {
-                    checked_idx_for_delete.insert(chosen_idx);
-                    auto stmt_chosen_idx = stmt_id(f_txn_id_queue, chosen_idx);
-                    for (int j = 0; j < stmt_num; j++) {
-                        if (i_idx_set.count(j) > 0) // exclude self ring
-                            continue;
-                        
-                        auto stmt_j = stmt_id(f_txn_id_queue, j);
-                        auto in_branch = make_pair(stmt_j, stmt_chosen_idx);
-                        if (tmp_stmt_dependency_graph.count(in_branch) > 0)
-                            edge_num++;
-                        auto out_branch = make_pair(stmt_chosen_idx, stmt_j);
-                        if (tmp_stmt_dependency_graph.count(out_branch) > 0)
-                            edge_num++;
-                    }
-                }
+        // no zero-indegree group, so there is a cycle
+        if (delete_flag != NULL)
+            *delete_flag = true;
 
-                if (edge_num >= max_edge_num) {
-                    max_edge_num = edge_num;
-                    target_idx = i;
-                }
+        // every cycle SCC of the alive groups needs a deletion, delete the group having 
+        // the most in-edges and out-edges of each one. if the rest is only blocked by the 
+        // deleted stmts that still have edges, delete such a group among all alive ones
+        for (auto& out_edges : group_edges)
+            out_edges.clear();
+        for (int i = 0; i < stmt_num; i++) {
+            auto g = instrument_group_of[i];
+            if (removed[i] || !is_alive(g) || !maybe_cyclic[g])
+                continue;
+            stmt_dependency_graph.out_edges(i, stmt_edges);
+            for (auto& edge : stmt_edges) {
+                auto j = edge.first;
+                auto h = instrument_group_of[j];
+                if (removed[j] || h == g || !is_alive(h) || !maybe_cyclic[h])
+                    continue;
+                auto types = edge.second & ~TOPO_SORT_ORDER_TYPES;
+                if (types != 0)
+                    group_edges[g].push_back(make_pair(h, types));
             }
-            auto select_stmt_id = stmt_id(f_txn_id_queue, target_idx);
-            
-            // delete its set (version_set, before_read, itself, after_read)
-            auto select_queue_idx = select_stmt_id.transfer_2_stmt_idx(f_txn_id_queue);
-            auto select_idx_set = get_instrumented_stmt_set(select_queue_idx);
-            // cerr << "Delete nodes: ";
-            for (auto chosen_idx : select_idx_set) {
-                auto chosen_stmt_id = stmt_id(f_txn_id_queue, chosen_idx);
-                deleted_nodes.insert(chosen_stmt_id);
-                for (int i = 0; i < stmt_num; i++) {
-                    auto out_branch = make_pair(chosen_stmt_id, stmt_id(f_txn_id_queue, i));
-                    auto in_branch = make_pair(stmt_id(f_txn_id_queue, i), chosen_stmt_id);
-                    tmp_stmt_dependency_graph.erase(out_branch);
-                    tmp_stmt_dependency_graph.erase(in_branch);
-                }
-                // cerr << chosen_stmt_id.txn_id << "." << chosen_stmt_id.stmt_idx_in_txn << ", ";
+        }
+        graph_cycle_info info;
+        find_graph_cycle(group_edges, info);
+        maybe_cyclic.assign(instrument_group_num, false);
+        for (auto& scc : info.cycle_sccs) {
+            for (auto g : scc)
+                maybe_cyclic[g] = true;
+        }
+        if (!info.has_cycle()) {
+            info.cycle_sccs.push_back(vector<int>());
+            for (int g = 0; g < instrument_group_num; g++) {
+                if (is_alive(g))
+                    info.cycle_sccs.back().push_back(g);
             }
-            // cerr << "max_edge_num: " << max_edge_num << endl;
-            continue;
         }
-        // ------------------------------------
-        
-        // if do has zero-indegree statement, push the stmt and its stmt set (version_set, before_read, itself, after_read) to the path
-        set<int, less<int>> zero_idx_set = get_instrumented_stmt_set(zero_indegree_idx);
-        for (auto output_idx : zero_idx_set) {
-            auto output_stmt_id = stmt_id(f_txn_id_queue, output_idx);
-            path.push_back(output_stmt_id);
-
-            // mark the outputted node, and delete its edges.
-            outputted_node.insert(output_stmt_id);
-            for (int j = 0; j < stmt_num; j++) {
-                auto stmt_j = stmt_id(f_txn_id_queue, j);
-                auto out_branch = make_pair(output_stmt_id, stmt_j);
-                auto in_branch = make_pair(stmt_j, output_stmt_id);
-                tmp_stmt_dependency_graph.erase(out_branch);
-                tmp_stmt_dependency_graph.erase(in_branch);
+
+        bool deleted = false;
+        for (auto& scc : info.cycle_sccs) {
+            int target = -1;
+            for (auto g : scc) {
+                if (target == -1 ||
+                        make_pair(in_degree[g] + out_degree[g], first_alive[g]) > 
+                        make_pair(in_degree[target] + out_degree[target], first_alive[target]))
+                    target = g;
             }
+            if (target == -1)
+                continue;
+            retire_group(target, false);
+            deleted = true;
         }
+        if (!deleted) // all alive stmts are outputted
+            break;
     }
 
-    auto path_size = path.size();
-    // delete begin stmts and commit/abort stmts
-    for (int i = 0; i < path_size; i++) {
-        auto txn_id = path[i].txn_id;
-        auto stmt_pos = path[i].stmt_idx_in_txn;
-        if (stmt_pos != 0 && f_txn_size[txn_id] != stmt_pos + 1)
+    // delete begin stmts and commit/abort stmts, and the replaced stmts
+    int kept = 0;
+    for (auto& sid : path) {
+        if (sid.stmt_idx_in_txn == 0 || f_txn_size[sid.txn_id] == sid.stmt_idx_in_txn + 1)
             continue;
-        // if it is the first one (begin), or last one (commit), delete it
-        path.erase(path.begin() + i);
-        path_size--;
-        i--;
-    }
-
-    // delete replaced stmts
-    for (int i = 0; i < path_size; i++) {
-        auto queue_idx = path[i].transfer_2_stmt_idx(f_txn_id_queue);
-        if (f_stmt_usage[queue_idx] != INIT_TYPE)
+        if (f_stmt_usage[get_queue_idx(sid)] == INIT_TYPE)
             continue;
-        path.erase(path.begin() + i);
-        path_size--;
-        i--;
+        path[kept++] = sid;
     }
+    path.resize(kept);
 
     return path;
 }
 
 
-// has cycle: cycle_nodes is not empty
+// has cycle: cycle_nodes (the txns in the cycle SCCs) is not empty
 // no cycle: cycle_nodes is empty, and sorted_nodes is the topo-sorted txn sequence
 void dependency_analyzer::check_txn_graph_cycle(set<int>& cycle_nodes, vector<int>& sorted_nodes)
 {
-    set<int> removed_txn;
-    // remove abort txn
-    for (int i = 0; i < tid_num; i++) {
-        if (f_txn_status[i] == TXN_ABORT)
-            removed_txn.insert(i);
-    }
-    removed_txn.insert(tid_num - 1); // remove the init txn
-
+    depend_mask cycle_types = DEPEND_BIT(WRITE_READ) | DEPEND_BIT(WRITE_WRITE) | DEPEND_BIT(READ_WRITE) |
+                                DEPEND_BIT(VERSION_SET_DEPEND) | DEPEND_BIT(OVERWRITE_DEPEND);
+    graph_cycle_info info;
+    find_txn_cycle(cycle_types, info, true);
+    
     cycle_nodes.clear();
-    sorted_nodes.clear();
-    while (removed_txn.size() < tid_num) {
-        int zero_indegree_idx = -1;
-        for (int i = 0; i < tid_num; i++) {
-            if (removed_txn.count(i) > 0)
-                continue;
-            bool has_indegree = false;
-            for (int j = 0; j < tid_num; j++) {
-                if (removed_txn.count(j) > 0)
-                    continue;
-                if (dependency_graph[j][i].count(WRITE_READ) || 
-                    dependency_graph[j][i].count(WRITE_WRITE) ||
-                    dependency_graph[j][i].count(READ_WRITE) ||
-                    dependency_graph[j][i].count(VERSION_SET_DEPEND) ||
-                    dependency_graph[j][i].count(OVERWRITE_DEPEND))
-                // if (dependency_graph[j][i].size() > 0) 
-                {
-                    has_indegree = true;
-                    break;
-                }
-            }
-            if (has_indegree == false) {
-                zero_indegree_idx = i;
-                break;
-            }
+    for (auto& scc : info.cycle_sccs)
+        cycle_nodes.insert(scc.begin(), scc.end());
+    sorted_nodes = info.sorted_nodes;
+    if (info.has_cycle())
+        print_cycle_witness(info, false);
+    return;
+}
+
+// in-place backtracking state of the enumeration, a node is an instrumentation group
+struct topo_enum_state {
+    vector<int> indegree; // in-edges from the unplaced stmts of other groups
+    vector<bool> placed; // put into the path, or all its stmts are deleted
+    vector<bool> read_only; // no write stmt in the group
+    vector<int> group_order; // the alive groups, ordered by their first alive stmt
+    vector<vector<int>> out_groups; // the target group of each out-edge of the alive stmts
+    vector<vector<stmt_id>> group_stmts;
+    vector<stmt_id> path;
+    int last_group; // the group placed last, -1 for none
+    bool dedup_read_only;
+
+    bool can_place(int g) {
+        if (placed[g] || indegree[g] != 0)
+            return false;
+        if (dedup_read_only && last_group != -1 && 
+                read_only[last_group] && read_only[g] && g < last_group &&
+                find(out_groups[last_group].begin(), out_groups[last_group].end(), g) == out_groups[last_group].end())
+            return false; // g was ready before last_group, keep the ascending order of the two
+        return true;
+    }
+    void place(int g) {
+        placed[g] = true;
+        for (auto h : out_groups[g])
+            indegree[h]--;
+        path.insert(path.end(), group_stmts[g].begin(), group_stmts[g].end());
+        last_group = g;
+    }
+    void unplace(int g, int prev_last_group) {
+        placed[g] = false;
+        for (auto h : out_groups[g])
+            indegree[h]++;
+        path.resize(path.size() - group_stmts[g].size());
+        last_group = prev_last_group;
+    }
+    // memo key of the enumeration from this state
+    string key() {
+        string res(placed.size(), '0');
+        for (int g = 0; g < placed.size(); g++) {
+            if (placed[g])
+                res[g] = '1';
         }
-        if (zero_indegree_idx == -1)  // no zero indegree txn, has cycle
-            break;
-        removed_txn.insert(zero_indegree_idx);
-        sorted_nodes.push_back(zero_indegree_idx);
+        if (dedup_read_only && last_group != -1 && read_only[last_group])
+            res += to_string(last_group);
+        return res;
     }
+};
 
-    for (int i = 0; i < tid_num; i++) {
-        if (removed_txn.count(i) > 0)
+// enumerate the orders in DFS, stop at max_path_num (0: no limit) or when stop is set
+static void topo_enum_dfs(topo_enum_state& state, vector<vector<stmt_id>>& total_path,
+                            int max_path_num, atomic<bool>& stop, ostream* report)
+{
+    bool flag = false;
+    for (auto g : state.group_order) {
+        if (state.placed[g] || state.indegree[g] != 0)
+            continue;
+        flag = true; // not a leaf, even if the order is pruned
+        if (!state.can_place(g))
             continue;
-        cycle_nodes.insert(i);
+        auto prev_last_group = state.last_group;
+        state.place(g);
+        topo_enum_dfs(state, total_path, max_path_num, stop, report);
+        state.unplace(g, prev_last_group);
+        if (stop || (max_path_num > 0 && total_path.size() >= max_path_num))
+            return;
+    }
+
+    if (flag == false) {
+        total_path.push_back(state.path);
+        if (total_path.size() % 1000 == 0)
+            *report << "total path num: " << total_path.size() << endl;
     }
-    return;
 }
 
-vector<vector<stmt_id>> dependency_analyzer::get_all_topo_sort_path()
+vector<vector<stmt_id>> dependency_analyzer::get_all_topo_sort_path(topo_sort_option option)
 {
     vector<stmt_id> path;
     auto tmp_stmt_dependency_graph = stmt_dependency_graph;
@@ -1639,142 +2089,430 @@ vector<vector<stmt_id>> dependency_analyzer::get_all_topo_sort_path()
         auto txn_id = f_txn_id_queue[i];
         if (f_txn_status[txn_id] == TXN_COMMIT)
             continue;
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = get_stmt_id(i);
         deleted_nodes.insert(stmt_i); 
-        for (int j = 0; j < stmt_num; j++) {
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
-            auto out_branch = make_pair(stmt_i, stmt_j);
-            auto in_branch = make_pair(stmt_j, stmt_i);
-            tmp_stmt_dependency_graph.erase(out_branch);
-            tmp_stmt_dependency_graph.erase(in_branch);
-        }
+        tmp_stmt_dependency_graph.delete_node(i);
     }
 
     for (int i = 0; i < stmt_num; i++) {
     	if (f_stmt_usage[i] != INIT_TYPE)
 	    continue;
-	auto stmt_i = stmt_id(f_txn_id_queue, i);
+	auto stmt_i = get_stmt_id(i);
         deleted_nodes.insert(stmt_i);
-        for (int j = 0; j < stmt_num; j++) {
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
-            auto out_branch = make_pair(stmt_i, stmt_j);
-            auto in_branch = make_pair(stmt_j, stmt_i);
-            tmp_stmt_dependency_graph.erase(out_branch);
-            tmp_stmt_dependency_graph.erase(in_branch);
-        }
+        tmp_stmt_dependency_graph.delete_node(i);
     }
 
     // delete start and inner dependency
-    for (int i = 0; i < stmt_num; i++) {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
-        for (int j = i; j < stmt_num; j++) {
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
-            auto out_branch = make_pair(stmt_i, stmt_j);
-            auto in_branch = make_pair(stmt_j, stmt_i);
-            if (tmp_stmt_dependency_graph.count(out_branch)) {
-                tmp_stmt_dependency_graph[out_branch].erase(START_DEPEND);
-                tmp_stmt_dependency_graph[out_branch].erase(STRICT_START_DEPEND);
-                tmp_stmt_dependency_graph[out_branch].erase(INNER_DEPEND);
-                if (tmp_stmt_dependency_graph[out_branch].empty())
-                    tmp_stmt_dependency_graph.erase(out_branch);
-            }
-            if (tmp_stmt_dependency_graph.count(in_branch)) {
-                tmp_stmt_dependency_graph[in_branch].erase(START_DEPEND);
-                tmp_stmt_dependency_graph[in_branch].erase(STRICT_START_DEPEND);
-                tmp_stmt_dependency_graph[in_branch].erase(INNER_DEPEND);
-                if (tmp_stmt_dependency_graph[in_branch].empty())
-                    tmp_stmt_dependency_graph.erase(in_branch);
-            }
-        }
-    }
+    tmp_stmt_dependency_graph.remove_types(TOPO_SORT_ORDER_TYPES);
 
-    vector<stmt_id> current_path;
-    vector<vector<stmt_id>> total_path;
     auto path_nodes = topological_sort_path(deleted_nodes);
     set<stmt_id> path_nodes_set;
     for (auto node: path_nodes)
         path_nodes_set.insert(node);
+    vector<bool> is_alive(stmt_num, false);
     for (int i = 0; i < stmt_num; i++) {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = get_stmt_id(i);
         if (path_nodes_set.count(stmt_i) == 0)
             deleted_nodes.insert(stmt_i);
+        is_alive[i] = deleted_nodes.count(stmt_i) == 0;
+    }
+
+    // a group is enumerated if it has an alive stmt, and it is ready when no 
+    // alive stmt of other groups points to any of its stmts
+    topo_enum_state state;
+    state.indegree.assign(instrument_group_num, 0);
+    state.placed.assign(instrument_group_num, true);
+    state.read_only.assign(instrument_group_num, true);
+    state.out_groups.assign(instrument_group_num, vector<int>());
+    state.group_stmts.assign(instrument_group_num, vector<stmt_id>());
+    state.last_group = -1;
+    state.dedup_read_only = option.dedup_read_only;
+    for (int i = 0; i < stmt_num; i++) {
+        auto g = instrument_group_of[i];
+        if (f_stmt_usage[i] == UPDATE_WRITE || f_stmt_usage[i] == DELETE_WRITE || f_stmt_usage[i] == INSERT_WRITE)
+            state.read_only[g] = false;
+        if (!is_alive[i] || state.placed[g] == false)
+            continue;
+        state.placed[g] = false;
+        state.group_order.push_back(g);
+    }
+    for (int g = 0; g < instrument_group_num; g++) {
+        for (auto it = group_begin(g); it != group_end(g); it++)
+            state.group_stmts[g].push_back(get_stmt_id(*it));
+    }
+    vector<int> out;
+    for (int j = 0; j < stmt_num; j++) {
+        if (!is_alive[j])
+            continue;
+        auto g = instrument_group_of[j];
+        tmp_stmt_dependency_graph.out_neighbours(j, out);
+        for (auto x : out) {
+            auto h = instrument_group_of[x];
+            if (h == g || state.placed[h])
+                continue;
+            state.out_groups[g].push_back(h);
+            state.indegree[h]++;
+        }
+    }
+
+    vector<vector<stmt_id>> total_path;
+    if (option.sample_num > 0) {
+        sample_topo_sort(state, option.sample_num, total_path);
+        return total_path;
+    }
+
+    atomic<bool> stop(false);
+    if (option.thread_num <= 1) {
+        topo_enum_dfs(state, total_path, option.max_path_num, stop, report);
+        return total_path;
+    }
+
+    // split the first levels into prefixes (in DFS order), the threads take them one by one
+    vector<vector<int>> tasks(1);
+    for (int depth = 0; depth < 3 && tasks.size() < 4 * option.thread_num; depth++) {
+        vector<vector<int>> next_tasks;
+        for (auto& prefix : tasks) {
+            auto prev_last_group = state.last_group;
+            for (auto g : prefix) 
+                state.place(g);
+            bool has_child = false;
+            for (auto g : state.group_order) {
+                if (state.placed[g] || state.indegree[g] != 0)
+                    continue;
+                has_child = true;
+                if (!state.can_place(g))
+                    continue;
+                next_tasks.push_back(prefix);
+                next_tasks.back().push_back(g);
+            }
+            if (has_child == false) // a complete order
+                next_tasks.push_back(prefix);
+            for (int k = prefix.size() - 1; k >= 0; k--) 
+                state.unplace(prefix[k], k > 0 ? prefix[k - 1] : prev_last_group);
+        }
+        tasks = next_tasks;
+    }
+
+    vector<vector<vector<stmt_id>>> task_path(tasks.size());
+    vector<bool> task_done(tasks.size(), false);
+    atomic<int> next_task(0);
+    mutex done_mutex;
+    auto worker = [&]() {
+        while (!stop) {
+            int t = next_task++;
+            if (t >= tasks.size())
+                break;
+            auto task_state = state;
+            for (auto g : tasks[t])
+                task_state.place(g);
+            topo_enum_dfs(task_state, task_path[t], option.max_path_num, stop, report);
+
+            // stop when the finished prefix of tasks has enough orders
+            lock_guard<mutex> lock(done_mutex);
+            task_done[t] = true;
+            size_t done_num = 0;
+            for (int k = 0; k < tasks.size() && task_done[k]; k++)
+                done_num += task_path[k].size();
+            if (option.max_path_num > 0 && done_num >= option.max_path_num)
+                stop = true;
+        }
+    };
+    vector<thread> workers;
+    for (int i = 0; i < option.thread_num; i++)
+        workers.push_back(thread(worker));
+    for (auto& w : workers)
+        w.join();
+
+    for (auto& one_task_path : task_path) {
+        for (auto& one_path : one_task_path) {
+            if (option.max_path_num > 0 && total_path.size() >= option.max_path_num)
+                break;
+            total_path.push_back(one_path);
+        }
     }
-    recur_topo_sort(current_path, deleted_nodes, total_path, tmp_stmt_dependency_graph);
     return total_path;
 }
 
-void dependency_analyzer::recur_topo_sort(vector<stmt_id> current_path,
-                                          set<stmt_id> deleted_nodes,
-                                          vector<vector<stmt_id>>& total_path,
-                                          map<pair<stmt_id, stmt_id>, set<dependency_type>>& graph)
+// the number of orders from the state, false if the memo is too large
+bool dependency_analyzer::count_topo_sort(topo_enum_state& state, 
+                    unordered_map<string, long double>& memo, long double& res)
 {
+    auto key = state.key();
+    auto memo_it = memo.find(key);
+    if (memo_it != memo.end()) {
+        res = memo_it->second;
+        return true;
+    }
+    if (memo.size() >= TOPO_SAMPLE_MEMO_LIMIT)
+        return false;
+
+    res = 0;
     bool flag = false;
-    set<int> visited_instrument;
-    for (int i = 0; i < stmt_num; i++) {
-	if (visited_instrument.count(i) > 0)
-	    continue;
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
-        if (deleted_nodes.count(stmt_i) > 0) // has been visited
+    for (auto g : state.group_order) {
+        if (state.placed[g] || state.indegree[g] != 0)
             continue;
-        bool has_indegree = false;
-
-        // get its set (version_set, before_read, itself, after_read)
-        // check whether the node and its set have indegree
-        set<int, less<int>> i_idx_set = get_instrumented_stmt_set(i);
-        for (auto chosen_idx : i_idx_set) {
-            visited_instrument.insert(chosen_idx);
-	    auto stmt_chosen_idx = stmt_id(f_txn_id_queue, chosen_idx);
-            for (int j = 0; j < stmt_num; j++) {
-                if (i_idx_set.count(j) > 0) // exclude self ring
-                    continue;
-                auto stmt_j = stmt_id(f_txn_id_queue, j);
-                if (deleted_nodes.count(stmt_j) > 0) // has been visited
-                    continue;
-                
-                auto in_branch = make_pair(stmt_j, stmt_chosen_idx);
-                if (graph.count(in_branch) == 0)
+        flag = true;
+        if (!state.can_place(g))
+            continue;
+        auto prev_last_group = state.last_group;
+        long double sub_res;
+        state.place(g);
+        auto succeed = count_topo_sort(state, memo, sub_res);
+        state.unplace(g, prev_last_group);
+        if (!succeed)
+            return false;
+        res += sub_res;
+    }
+    if (flag == false)
+        res = 1;
+    memo[key] = res;
+    return true;
+}
+
+// each next group is chosen with the probability of (orders after it / orders now),
+// so every order has the same probability. if there are too many states to count,
+// choose the next group uniformly instead
+void dependency_analyzer::sample_topo_sort(topo_enum_state& state, int sample_num, 
+                    vector<vector<stmt_id>>& total_path)
+{
+    unordered_map<string, long double> memo;
+    long double all_num;
+    bool is_uniform = count_topo_sort(state, memo, all_num);
+    if (!is_uniform)
+        *report << "sample_topo_sort: too many states to count, the samples are not uniform" << endl;
+
+    for (int k = 0; k < sample_num; k++) {
+        auto sample_state = state;
+        if (!is_uniform) // the pruning of dedup_read_only may lead to dead ends
+            sample_state.dedup_read_only = false;
+        while (true) {
+            vector<int> choices;
+            vector<long double> weights;
+            long double weight_sum = 0;
+            for (auto g : sample_state.group_order) {
+                if (!sample_state.can_place(g))
                     continue;
-                has_indegree = true; // have other depends
+                long double w = 1;
+                if (is_uniform) {
+                    auto prev_last_group = sample_state.last_group;
+                    sample_state.place(g);
+                    w = memo[sample_state.key()];
+                    sample_state.unplace(g, prev_last_group);
+                }
+                choices.push_back(g);
+                weights.push_back(w);
+                weight_sum += w;
+            }
+            if (choices.empty())
                 break;
+            long double r = (long double)rand() / ((long double)RAND_MAX + 1) * weight_sum;
+            int c = 0;
+            while (c + 1 < choices.size() && r >= weights[c]) {
+                r -= weights[c];
+                c++;
             }
-            if (has_indegree == true) 
+            sample_state.place(choices[c]);
+        }
+        total_path.push_back(sample_state.path);
+    }
+}
+
+stream_analyzer::stream_analyzer(vector<stmt_output>& init_output,
+                                int t_num,
+                                int primary_key_idx,
+                                int write_op_key_idx):
+tid_num(t_num + 1), // add 1 for init txn
+stmt_num(0),
+primary_key_index(primary_key_idx),
+version_key_index(write_op_key_idx),
+is_consistent(true),
+report(&cerr),
+prev_tid(-1),
+prev_usage(INIT_TYPE, false),
+open_version_set_tid(-1)
+{
+    f_txn_status.assign(tid_num, NOT_DEFINED);
+    f_txn_status[tid_num - 1] = TXN_COMMIT; // for init txn
+    wr_graph.assign(tid_num, vector<bool>(tid_num, false));
+    ww_wr_graph.assign(tid_num, vector<bool>(tid_num, false));
+
+    for (auto& each_output : init_output) {
+        for (auto& row : each_output) {
+            auto row_id = stoi(row[primary_key_idx]);
+            auto write_op_id = stoi(row[write_op_key_idx]);
+            auto row_ref = rows.intern(row);
+            operate_unit op(stmt_usage(AFTER_WRITE_READ, false), write_op_id, tid_num - 1, -1, row_id, row_ref);
+            h.insert_to_history(op);
+        }
+    }
+}
+
+// the same rules as build_stmt_instrument_dependency(), but checked when the
+// statement arrives. BEFORE_WRITE_READ and VERSION_SET_READ are checked by
+// the following statements.
+bool stream_analyzer::check_instrument(int tid, stmt_usage& stmt_u)
+{
+    if (prev_usage == BEFORE_WRITE_READ) {
+        if (tid != prev_tid)
+            return false;
+        if (stmt_u != UPDATE_WRITE && stmt_u != DELETE_WRITE)
+            return false;
+    }
+    if (stmt_u == AFTER_WRITE_READ) {
+        if (tid != prev_tid)
+            return false;
+        if (prev_usage != UPDATE_WRITE && prev_usage != INSERT_WRITE)
+            return false;
+    }
+    if (open_version_set_tid != -1 && tid != open_version_set_tid)
+        return false;
+
+    if (stmt_u == VERSION_SET_READ)
+        open_version_set_tid = tid;
+    else if (stmt_u == SELECT_READ || 
+            stmt_u == UPDATE_WRITE || 
+            stmt_u == DELETE_WRITE || 
+            stmt_u == INSERT_WRITE)
+        open_version_set_tid = -1;
+    prev_tid = tid;
+    prev_usage = stmt_u;
+    return true;
+}
+
+void stream_analyzer::consume_stmt(int tid, stmt_usage& stmt_u, const stmt_output& output)
+{
+    auto stmt_idx = stmt_num;
+    stmt_num++;
+    if (is_consistent == false)
+        return;
+    if (check_instrument(tid, stmt_u) == false) {
+        *report << "stream_analyzer: instrumentation is broken at " << stmt_idx << ", stop streaming check" << endl;
+        is_consistent = false;
+        return;
+    }
+
+    for (auto& row : output) {
+        int row_id, write_op_id;
+        try {
+            row_id = stoi(row[primary_key_index]);
+            write_op_id = stoi(row[version_key_index]);
+        } catch (exception &e) {
+            is_consistent = false; // let dependency_analyzer report it
+            return;
+        }
+        auto row_ref = rows.intern(row);
+        operate_unit op(stmt_u, write_op_id, tid, stmt_idx, row_id, row_ref);
+        auto row_idx = h.insert_to_history(op);
+        auto& op_list = h.change_history[row_idx].row_op_list;
+        process_op(op_list, op_list.size() - 1, row_idx);
+    }
+}
+
+void stream_analyzer::process_op(vector<operate_unit>& op_list, int op_idx, int row_idx)
+{
+    auto& target_op = op_list[op_idx];
+    auto tid = target_op.tid;
+
+    // WR (and WW for BEFORE_WRITE_READ) from the nearest write, as build_WR_dependency()
+    if (target_op.stmt_u != AFTER_WRITE_READ) {
+        int write_idx = op_idx - 1;
+        for (; write_idx >= 0; write_idx--) {
+            if (op_list[write_idx].stmt_u == AFTER_WRITE_READ && 
+                    op_list[write_idx].row_ref == target_op.row_ref)
                 break;
         }
-        if (has_indegree == true)
-            continue; 
-        
-        // a zero indegree node and its set "i_idx_set"
-        auto tmp_current_path = current_path;
-        auto tmp_deleted_nodes = deleted_nodes;
-        for (auto idx : i_idx_set) {
-            auto chosen_stmt_id = stmt_id(f_txn_id_queue, idx);
-            current_path.push_back(chosen_stmt_id);
-            deleted_nodes.insert(chosen_stmt_id);
-        }
-        recur_topo_sort(current_path, deleted_nodes, total_path, graph);
-
-        // resetting visiting
-        // current_path.pop_back();
-        // deleted_nodes = tmp_deleted_nodes;
-	for (auto idx : i_idx_set) {
-            auto chosen_stmt_id = stmt_id(f_txn_id_queue, idx);
-            current_path.pop_back();
-            deleted_nodes.erase(chosen_stmt_id);
+        if (write_idx < 0) {
+            *report << "Read stmt idx: " << target_op.stmt_idx << endl;
+            *report << "Read stmt tid: " << tid << endl;
+            throw runtime_error("BUG: Cannot find the corresponding write (stream_analyzer)");
+        }
+        auto write_tid = op_list[write_idx].tid;
+        if (write_tid != tid) {
+            wr_graph[write_tid][tid] = true;
+            ww_wr_graph[write_tid][tid] = true;
         }
-        flag = true;
     }
 
-    if (flag == false) { 
-        total_path.push_back(current_path);
-	/*
-	cerr << "current path: ";
-	for (auto node : current_path) {
-	    cerr << "(" << node.txn_id << "," << node.stmt_idx_in_txn << ")->";
-	}
-	cerr << endl;
-	*/
-	if (total_path.size() % 1000 == 0)
-	    cerr << "total path num: " << total_path.size() << endl;
+    // G1b, as check_G1b(): the version written by Ti is read by others
+    // before Ti ends, and Ti rewrites the row. the running writes of the row
+    // are kept per version and per txn, as classify_intermediate_reads()
+    if ((int)row_versions.size() <= row_idx) {
+        row_versions.resize(row_idx + 1);
+        row_txn_versions.resize(row_idx + 1);
+    }
+    auto& versions = row_versions[row_idx];
+    auto check_version = [&](version_write& v) {
+        if (v.other_read == false || v.rewritten == false)
+            return;
+        if (f_txn_status[v.tid] != NOT_DEFINED) // ended (or init txn)
+            return;
+        *report << "first_write tid: " << v.tid << " stmt idx: " << v.stmt_idx << endl;
+        *report << "current op tid: " << tid << " stmt idx: " << target_op.stmt_idx << endl;
+        throw runtime_error("BUG: found in stream_analyzer, G1b violate");
+    };
+    auto version_it = versions.find(target_op.write_op_id);
+    if (version_it != versions.end() && version_it->second.tid != tid) {
+        version_it->second.other_read = true;
+        check_version(version_it->second);
+    }
+    if (target_op.stmt_u == BEFORE_WRITE_READ) {
+        auto& txn_versions = row_txn_versions[row_idx][tid];
+        for (auto write_op_id : txn_versions) {
+            auto& v = versions[write_op_id];
+            v.rewritten = true;
+            check_version(v);
+        }
+        txn_versions.clear(); // rewritten stays set
+    }
+    if (target_op.stmt_u == AFTER_WRITE_READ && version_it == versions.end()) {
+        versions[target_op.write_op_id] = {tid, target_op.stmt_idx, false, false};
+        row_txn_versions[row_idx][tid].push_back(target_op.write_op_id);
+    }
+}
+
+bool stream_analyzer::reach_committed(int from, int to, vector<bool>& visited)
+{
+    for (int next = 0; next < tid_num; next++) {
+        if (ww_wr_graph[from][next] == false || f_txn_status[next] != TXN_COMMIT)
+            continue;
+        if (next == to)
+            return true;
+        if (visited[next])
+            continue;
+        visited[next] = true;
+        if (reach_committed(next, to, visited))
+            return true;
+    }
+    return false;
+}
+
+void stream_analyzer::finish_txn(int tid, txn_status status)
+{
+    f_txn_status[tid] = status;
+    if (is_consistent == false)
+        return;
+    
+    // G1a: edges are only added while the reader is running, so the check
+    // is certain when the later one of writer and reader ends
+    for (int other = 0; other < tid_num; other++) {
+        if (status == TXN_COMMIT && f_txn_status[other] == TXN_ABORT && wr_graph[other][tid]) {
+            *report << "abort txn: " << other << endl;
+            *report << "commit txn: " << tid << endl;
+            throw runtime_error("BUG: found in stream_analyzer, G1a violate");
+        }
+        if (status == TXN_ABORT && f_txn_status[other] == TXN_COMMIT && wr_graph[tid][other]) {
+            *report << "abort txn: " << tid << endl;
+            *report << "commit txn: " << other << endl;
+            throw runtime_error("BUG: found in stream_analyzer, G1a violate");
+        }
+    }
+
+    // G1c: a cycle among committed txns is complete when its last txn commits
+    if (status != TXN_COMMIT)
+        return;
+    vector<bool> visited(tid_num, false);
+    if (reach_committed(tid, tid, visited)) {
+        *report << "have cycle in G1c, through txn " << tid << endl;
+        throw runtime_error("BUG: found in stream_analyzer, G1c violate");
     }
-    return;
 }
@@ -1,7 +1,7 @@
 #ifndef DEPENDENCY_ANALYZER_HH
 #define DEPENDENCY_ANALYZER_HH
 
-#include <ostream>
+#include <iostream>
 #include "relmodel.hh"
 #include <memory>
 #include "schema.hh"
@@ -11,8 +11,12 @@
 #include "grammar.hh"
 
 #include "instrumentor.hh"
+#include "dbms_info.hh"
+#include "row_hash.hh"
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <cstdint>
 #include <algorithm>
 
 using namespace std;
@@ -25,8 +29,122 @@ enum dependency_type {WRITE_READ, WRITE_WRITE, READ_WRITE,
                         INNER_DEPEND
                         }; // for predicate
 
+// histories having so many stmts are analyzed in large_history mode: the stmt graph
+// is sparse and only keeps the data (and instrument) edges
+#define LARGE_HISTORY_STMT_NUM 2048
+// in large_history mode, each decycling round of longest_stmt_path() deletes the groups of
+// 1 / LARGE_DECYCLE_BATCH_DIV of the live stmts in a cycle SCC (at least one)
+#define LARGE_DECYCLE_BATCH_DIV 64
+
+// a set of dependency_type as bits
+typedef uint16_t depend_mask;
+#define DEPEND_BIT(dt) ((depend_mask)(1 << (dt)))
+
+// statement dependency graph: a row-major matrix of depend_mask indexed by the
+// idx in f_txn_id_queue, or one edge list per stmt (sparse) for large histories.
+// no edge is 0
+struct stmt_graph {
+    int node_num;
+    bool sparse;
+    vector<depend_mask> adj; // adj[from * node_num + to]
+    // sparse_rows[from]: (to, types), sorted by to and merged by compact(), 
+    // which must be called after the edges are added and before get()
+    vector<vector<pair<int, depend_mask>>> sparse_rows;
+    // the neighbours of each node (ascending), built by compact() and kept by
+    // delete_node() and remove_types(), so that a node is deleted in O(degree)
+    vector<vector<int>> out_list;
+    vector<vector<int>> in_list;
+
+    stmt_graph(int n = 0) : node_num(n), sparse(false), adj((size_t)n * n, 0) {}
+    void reset(int n, bool is_sparse = false); // keep the capacity
+    void compact();
+    depend_mask get(int from, int to) const { 
+        if (!sparse)
+            return adj[(size_t)from * node_num + to];
+        auto& row = sparse_rows[from];
+        auto it = lower_bound(row.begin(), row.end(), make_pair(to, (depend_mask)0));
+        return (it == row.end() || it->first != to) ? 0 : it->second;
+    }
+    bool has_edge(int from, int to) const { return get(from, to) != 0; }
+    bool has_type(int from, int to, dependency_type dt) const { return (get(from, to) & DEPEND_BIT(dt)) != 0; }
+    void add_edge(int from, int to, dependency_type dt) { 
+        if (!sparse) {
+            adj[(size_t)from * node_num + to] |= DEPEND_BIT(dt); 
+            return;
+        }
+        auto& row = sparse_rows[from];
+        if (!row.empty() && row.back().first == to)
+            row.back().second |= DEPEND_BIT(dt);
+        else
+            row.push_back(make_pair(to, DEPEND_BIT(dt)));
+    }
+
+    // the dependency types in mask are removed from all edges
+    void remove_types(depend_mask mask);
+    // remove the in and out edges of node
+    void delete_node(int node);
+    void out_neighbours(int node, vector<int>& res) const;
+    // the out-edges of node with their types, without looking each one up
+    void out_edges(int node, vector<pair<int, depend_mask>>& res) const;
+    void in_neighbours(int node, vector<int>& res) const;
+    bool has_in_edge(int node) const;
+};
+
+#define DEPEND_TYPE_NUM (INNER_DEPEND + 1)
+#define BITSET_WORD_BITS 64
+
+// transaction dependency graph: one bitset row per dependency type and txn,
+// so that the rows of several types can be or-ed word by word
+struct txn_graph {
+    int node_num;
+    int word_num; // uint64_t words in a row
+    vector<uint64_t> bits; // row of (dt, from): bits[(dt * node_num + from) * word_num]
+
+    txn_graph(int n = 0) : node_num(n), word_num((n + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS), 
+        bits((size_t)DEPEND_TYPE_NUM * n * word_num, 0) {}
+    void reset(int n) { // keep the capacity
+        node_num = n;
+        word_num = (n + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+        bits.assign((size_t)DEPEND_TYPE_NUM * n * word_num, 0);
+    }
+    const uint64_t* row(int dt, int from) const { return &bits[((size_t)dt * node_num + from) * word_num]; }
+    void add_edge(int from, int to, dependency_type dt) { 
+        bits[((size_t)dt * node_num + from) * word_num + to / BITSET_WORD_BITS] |= 1ULL << (to % BITSET_WORD_BITS); 
+    }
+    bool has_type(int from, int to, dependency_type dt) const { 
+        return (row(dt, from)[to / BITSET_WORD_BITS] >> (to % BITSET_WORD_BITS)) & 1; 
+    }
+    depend_mask get(int from, int to) const; // all the types of the edge
+};
+
+// out-edges of each node with their types, the input of find_graph_cycle
+typedef vector<vector<pair<int, depend_mask>>> depend_adj_list;
+
+struct graph_cycle_info {
+    vector<vector<int>> cycle_sccs; // the SCCs having a cycle (more than one node, or a self loop)
+    // a shortest cycle through the root of a cycle SCC (the shortest one among 
+    // the SCCs): witness[0] -> witness[1] -> ... -> witness[0], 
+    // witness_types[i] is the types of the edge leaving witness[i]
+    vector<int> witness;
+    vector<depend_mask> witness_types;
+    vector<int> sorted_nodes; // topological order of the nodes that are not in cycle_sccs
+    bool has_cycle() { return !cycle_sccs.empty(); }
+};
+
+// one Tarjan traversal (and one BFS per cycle SCC for the witness), O(V + E)
+void find_graph_cycle(depend_adj_list& out_edges, graph_cycle_info& info);
+// the out-neighbours without edge types (witness_types are 0)
+void find_graph_cycle(vector<vector<int>>& out_nodes, graph_cycle_info& info);
+
+// weighted out-edges of each stmt (queue index, distance), the input of longest_stmt_path
+typedef vector<vector<pair<int, int>>> stmt_dist_list;
+
 typedef vector<string> row_output; // a row consists of several field(string)
 typedef vector<row_output> stmt_output; // one output consits of several rows
+// an output is produced once by the dut and then shared (read-only) by the 
+// txn record, the real queue and the analyzers
+typedef shared_ptr<const stmt_output> stmt_output_ref;
+stmt_output_ref empty_stmt_output(); // one shared empty output
 
 struct operate_unit {
     stmt_usage stmt_u;
@@ -34,11 +152,11 @@ struct operate_unit {
     int tid;
     int stmt_idx;
     int row_id;
-    size_t hash;
-    operate_unit(stmt_usage use, int op_id, int tid, int stmt_idx, int row_id, size_t hash):
+    int row_ref; // id of the whole row in row_interner
+    operate_unit(stmt_usage use, int op_id, int tid, int stmt_idx, int row_id, int row_ref):
         stmt_u(use), write_op_id(op_id), 
         tid(tid), stmt_idx(stmt_idx), 
-        row_id(row_id), hash(hash) {}
+        row_id(row_id), row_ref(row_ref) {}
 };
 
 struct row_change_history {
@@ -48,7 +166,9 @@ struct row_change_history {
 
 struct history {
     vector<row_change_history> change_history;
-    void insert_to_history(operate_unit& oper_unit);
+    unordered_map<int, int> row_id_to_idx; // row_id -> idx of the row in change_history
+    int insert_to_history(operate_unit& oper_unit); // return the idx of the row in change_history
+    void clear() { change_history.clear(); row_id_to_idx.clear(); }
 };
 
 struct stmt_id {
@@ -66,10 +186,45 @@ struct stmt_id {
             return this->txn_id < other_id.txn_id;
     }
 
-    stmt_id(vector<int>& final_tid_queue, int stmt_idx);
+    // the queue idx and the stmt_id of a history are converted by
+    // dependency_analyzer::get_queue_idx() and get_stmt_id()
     stmt_id() {txn_id = -1; stmt_idx_in_txn = -1;}
     stmt_id(int tid, int stmt_pos) {txn_id = tid; stmt_idx_in_txn = stmt_pos;}
-    int transfer_2_stmt_idx(vector<int>& final_tid_queue);
+};
+
+#define TOPO_SORT_PATH_LIMIT 1000
+// the edges only ordering the stmts, ignored by the topological sort
+#define TOPO_SORT_ORDER_TYPES (DEPEND_BIT(START_DEPEND) | DEPEND_BIT(STRICT_START_DEPEND) | DEPEND_BIT(INNER_DEPEND))
+#define TOPO_SAMPLE_MEMO_LIMIT (1 << 20) // down-sets whose order number is memorized
+
+// get_all_topo_sort_path enumerates the orders of the instrumentation groups
+struct topo_sort_option {
+    int max_path_num; // stop after so many orders, 0: no limit
+    int sample_num; // > 0: return sample_num uniformly random orders instead
+    // adjacent read-only groups commute (there is no edge between them), only
+    // keep the order in which each run of them is ascending
+    bool dedup_read_only;
+    int thread_num; // threads sharing the branches of the first levels
+
+    topo_sort_option(int max_num = TOPO_SORT_PATH_LIMIT, int samples = 0, 
+                    bool dedup = true, int threads = 1) : 
+        max_path_num(max_num), sample_num(samples), 
+        dedup_read_only(dedup), thread_num(threads) {}
+};
+
+struct topo_enum_state;
+
+// non-owning view of the stmt outputs (stored in place or shared), only read while the graphs are built
+struct stmt_output_view {
+    const stmt_output* outputs;
+    const stmt_output_ref* output_refs;
+    int output_num;
+
+    stmt_output_view() : outputs(NULL), output_refs(NULL), output_num(0) {}
+    stmt_output_view(const vector<stmt_output>& v) : outputs(v.data()), output_refs(NULL), output_num(v.size()) {}
+    stmt_output_view(const vector<stmt_output_ref>& v) : outputs(NULL), output_refs(v.data()), output_num(v.size()) {}
+    const stmt_output& operator[](int i) const { return outputs != NULL ? outputs[i] : *output_refs[i]; }
+    int size() const { return output_num; }
 };
 
 struct dependency_analyzer
@@ -82,14 +237,27 @@ struct dependency_analyzer
                         int t_num,
                         int primary_key_idx,
                         int write_op_key_idx);
-    ~dependency_analyzer();
+    dependency_analyzer() : tid_num(0), stmt_num(0), large_history(false), report(&cerr) {}
+
+    // analyze another history with the same object. the inputs are not kept (the
+    // outputs are only read through f_stmt_output during reset), and the graphs and
+    // scratch buffers are rewound in place, so that the refinement rounds of one
+    // test reuse their memory
+    void reset(const vector<stmt_output>& init_output,
+                stmt_output_view total_output,
+                const vector<int>& final_tid_queue,
+                const vector<stmt_usage>& final_stmt_usage,
+                const vector<txn_status>& final_txn_status,
+                int t_num,
+                int primary_key_idx,
+                int write_op_key_idx);
 
-    size_t hash_output(row_output& row);
     void build_WR_dependency(vector<operate_unit>& op_list, int op_idx);
     void build_RW_dependency(vector<operate_unit>& op_list, int op_idx);
     void build_WW_dependency(vector<operate_unit>& op_list, int op_idx);
 
-    // for predicate
+    // for predicate, the version reads are joined with indexes of the instrumented writes
+    void get_pv_pairs(int stmt_idx, vector<pair<int, int>>& pv_pairs); // (primary_key, version_key) of the output
     void build_VS_dependency();
     void build_OW_dependency();
     
@@ -97,7 +265,31 @@ struct dependency_analyzer
     void build_start_dependency();
     void build_stmt_instrument_dependency();
     set<int> get_instrumented_stmt_set(int queue_idx);
+
+    // instrumentation groups (a stmt with its before/after-write reads and version set reads),
+    // built once by union-find in build_stmt_instrument_dependency(). the members of group g 
+    // are [group_begin(g), group_end(g)) in ascending order
+    int instrument_group_num;
+    vector<int> instrument_group_of; // idx in f_txn_id_queue -> group
+    vector<int> instrument_group_begin; // group -> offset in instrument_group_members
+    vector<int> instrument_group_members;
+    const int* group_begin(int g) { return instrument_group_members.data() + instrument_group_begin[g]; }
+    const int* group_end(int g) { return instrument_group_members.data() + instrument_group_begin[g + 1]; }
+    // (from, to) of the INSTRUMENT_DEPEND edges, sorted. they are kept out of 
+    // stmt_dependency_graph, so that deleting stmts does not lose them
+    vector<pair<int, int>> instrument_links;
+    int find_instrument_root(vector<int>& group_dad, int idx);
+    void union_instrument_group(vector<int>& group_dad, int idx1, int idx2);
     void build_stmt_start_dependency(int prev_tid, int later_tid, dependency_type dt);
+    // the stored edge with the instrument link, and the implicit inner and start types in large_history mode
+    depend_mask get_stmt_depend(int stmt_idx1, int stmt_idx2);
+    // the stmts reached from stmt i by the edges having a type in edge_types, among the live
+    // ones (first_live_from[j]: the first live stmt of the txn of j from j on, -1: none), sorted.
+    // in large_history mode the implicit edges are reduced: the inner ones to the next live stmt 
+    // of the txn, the start ones to the first live stmt after i of each later txn (only if inner 
+    // edges are walked). the rest are reached through the inner chain, in more steps
+    void stmt_out_nodes(int i, depend_mask edge_types, const vector<int>& first_live_from, vector<int>& res);
+    void get_first_live_from(const vector<bool>& live, vector<int>& first_live_from);
 
     void print_dependency_graph();
     
@@ -115,6 +307,13 @@ struct dependency_analyzer
     // G2-item: Item Anti-dependency Cycles. A history H exhibits phenomenon G2-item
     // if DSG(H) contains a directed cycle having one or more item-anti-dependency edges.
     bool check_G2_item();
+    // G1a, G1b and G1c in one go: the reads of G1a and G1b are classified while reset() 
+    // walks the row histories to build the WR edges, G1c runs on the graph built by the walk
+    bool check_G1();
+    int g1a_abort_tid, g1a_commit_tid; // the smallest (aborted writer, committed reader), -1: none
+    // the first intermediate read: op idx in the row history g1b_row_idx, -1: none
+    int g1b_row_idx, g1b_first_write_idx, g1b_other_read_idx, g1b_second_write_idx;
+    void classify_intermediate_reads(vector<operate_unit>& op_list, int row_idx);
 
     // Snapshot Isolation:
     // G-SIa: Interference. A history H exhibits phenomenon G-SIa if SSG(H) contains a
@@ -125,16 +324,32 @@ struct dependency_analyzer
     // a directed cycle with exactly one anti-dependency edge.
     bool check_GSIb();
 
-    bool check_cycle(set<dependency_type>& edge_types);
-    static bool reduce_graph_indegree(int **direct_graph, int length);
-    static bool reduce_graph_outdegree(int **direct_graph, int length);
+    // run the G1, G2-item, G-SIa and G-SIb checks. true: one proscribed by level is found
+    bool check_isolation(isolation_level level);
+    string violated_check; // the anomaly found by the last check_isolation, empty: none
+    vector<string> allowed_anomalies; // found by the last check_isolation, but allowed by its level
+
+    // closure buffer of G-SIb: txn_reach[i] is the bitset of the txns
+    // reachable from i through the edges of the checked types
+    vector<uint64_t> txn_reach;
+    vector<uint64_t> committed_txn; // bitset of the committed txns
+    void build_txn_reach(depend_mask edge_types, bool skip_rw_only = false);
+    bool txn_reachable(int from, int to);
+
+    // SCC based cycle checks, only the edges having a type in edge_types are used.
+    // txn: the committed txns (skip_init_txn: except the init one), stmt: all the stmts (queue idx)
+    void find_txn_cycle(depend_mask edge_types, graph_cycle_info& info, bool skip_init_txn = false);
+    void find_stmt_cycle(depend_mask edge_types, graph_cycle_info& info);
+    void print_cycle_witness(graph_cycle_info& info, bool is_stmt_graph);
 
     history h;
     int tid_num;
     int stmt_num;
-    int* tid_begin_idx; // idx of first non-start transaction
-    int* tid_strict_begin_idx; // idx of start transaction
-    int* tid_end_idx;
+    bool large_history; // stmt_num >= LARGE_HISTORY_STMT_NUM
+    ostream* report; // where the graphs and the found anomalies are printed, cerr by default
+    vector<int> tid_begin_idx; // idx of first non-start transaction
+    vector<int> tid_strict_begin_idx; // idx of start transaction
+    vector<int> tid_end_idx;
 
     int primary_key_index;
     int version_key_index;
@@ -142,23 +357,105 @@ struct dependency_analyzer
     vector<txn_status> f_txn_status;
     vector<int> f_txn_id_queue;
     vector<int> f_txn_size;
+    // stmt_id <-> idx in f_txn_id_queue, built once in the constructor
+    vector<stmt_id> queue_idx_to_stmt_id;
+    vector<vector<int>> txn_stmt_queue_idx; // [txn_id][stmt_idx_in_txn] -> idx in f_txn_id_queue
+    stmt_id get_stmt_id(int queue_idx) { return queue_idx_to_stmt_id[queue_idx]; }
+    int get_queue_idx(const stmt_id& sid);
     vector<stmt_usage> f_stmt_usage;
-    vector<stmt_output> f_stmt_output;
-    map<int, row_output> hash_to_output;
-    set<dependency_type> **dependency_graph;
+    stmt_output_view f_stmt_output; // empty out of reset
+    row_interner rows;
+    txn_graph dependency_graph;
     void check_txn_graph_cycle(set<int>& cycle_nodes, vector<int>& sorted_nodes);
 
-    map<pair<stmt_id, stmt_id>, set<dependency_type>> stmt_dependency_graph;
+    stmt_graph stmt_dependency_graph;
     void build_stmt_depend_from_stmt_idx(int stmt_idx1, int stmt_idx2, dependency_type dt);
-    vector<stmt_id> longest_stmt_path(map<pair<stmt_id, stmt_id>, int>& stmt_dist_graph);
+    vector<stmt_id> longest_stmt_path(stmt_dist_list& stmt_dist_graph);
     vector<stmt_id> longest_stmt_path();
-    vector<stmt_id> topological_sort_path(set<stmt_id> deleted_nodes, bool* delete_flag = NULL);
+    // the weighted edges of longest_stmt_path() between the live stmts
+    void build_stmt_dist_graph(const vector<bool>& live, stmt_dist_list& stmt_dist_graph);
+    // large histories: the strict start edges kept in the decycling graph, from the last stmt
+    // before each run of the stmts of the later txn
+    void get_strict_start_edges(vector<pair<int, int>>& edges);
+    // large histories: the unweighted stmt_dist_graph on 2 * stmt_num nodes. a deleted stmt i
+    // only passes the implicit edges on: node i is reached by the inner edges and goes on by 
+    // the implicit ones, node stmt_num + i is reached by the strict start edges and only goes 
+    // on by the inner one
+    void build_stmt_pass_graph(const vector<bool>& deleted, const vector<bool>& on_cycle,
+            const vector<pair<int, int>>& start_edges, vector<vector<int>>& graph);
+    // delete the group of one random live stmt (of 1 / batch_div of them if batch_div is set) in
+    // each cycle SCC of graph. false: no cycle. on_cycle: the nodes of those SCCs, the later 
+    // cycles can only be among them
+    bool delete_cycle_groups(vector<vector<int>>& graph, vector<bool>& deleted, vector<bool>& on_cycle, int batch_div = 0);
+    // groups of the committed stmts in topological order (the ready group having the latest 
+    // stmt first), cycles are broken by deleting groups (delete_flag is set)
+    vector<stmt_id> topological_sort_path(const set<stmt_id>& deleted_nodes, bool* delete_flag = NULL);
+
+    // edges of topological_sort_path: the stmt edges between different groups, without 
+    // the start, strict start and inner types. the in/out edge num of each group is 
+    // counted by reset() and kept by delete_stmt()
+    vector<int> group_in_degree;
+    vector<int> group_out_degree;
+    vector<bool> stmt_deleted; // by delete_stmt()
+    // remove the edges of a stmt (the instrument links are kept) in O(degree)
+    void delete_stmt(int queue_idx);
+    void update_group_degree(int stmt_idx, int delta, vector<int>& in_degree, 
+                                vector<int>& out_degree, const vector<bool>& removed);
+
+    vector<vector<stmt_id>> get_all_topo_sort_path(topo_sort_option option = topo_sort_option());
+    bool count_topo_sort(topo_enum_state& state, unordered_map<string, long double>& memo, long double& res);
+    void sample_topo_sort(topo_enum_state& state, int sample_num, vector<vector<stmt_id>>& total_path);
+};
+
+// Streaming version of G1a, G1b, G1c and the missing-write check. It consumes
+// the executed statements in the real order (as trans_test produces them), so
+// that a violation can be reported before the whole history is executed.
+// It only concludes on an instrument-consistent prefix: once the prefix breaks
+// the instrumentation rules of build_stmt_instrument_dependency(), it stays
+// silent and leaves the decision to dependency_analyzer.
+struct stream_analyzer
+{
+    stream_analyzer(vector<stmt_output>& init_output,
+                    int t_num,
+                    int primary_key_idx,
+                    int write_op_key_idx);
+
+    // throw runtime_error containing "BUG" when a violation is certain
+    void consume_stmt(int tid, stmt_usage& stmt_u, const stmt_output& output);
+    void finish_txn(int tid, txn_status status);
+
+    history h;
+    row_interner rows;
+    int tid_num;
+    int stmt_num;
+    int primary_key_index;
+    int version_key_index;
+    bool is_consistent;
+    ostream* report; // where the found anomalies are printed, cerr by default
+
+    vector<txn_status> f_txn_status; // NOT_DEFINED before commit or abort
+    vector<vector<bool>> wr_graph;
+    vector<vector<bool>> ww_wr_graph;
+
+    // pending instrumentation requirements of the prefix
+    int prev_tid;
+    stmt_usage prev_usage;
+    int open_version_set_tid;
+
+    // the first write of each version in a row, and whether it has been read by
+    // another txn and rewritten by its own txn since
+    struct version_write {
+        int tid;
+        int stmt_idx;
+        bool other_read;
+        bool rewritten;
+    };
+    vector<unordered_map<int, version_write>> row_versions; // row idx -> write_op_id -> write
+    vector<unordered_map<int, vector<int>>> row_txn_versions; // row idx -> tid -> versions not rewritten yet
 
-    vector<vector<stmt_id>> get_all_topo_sort_path();
-    void recur_topo_sort(vector<stmt_id> current_path,
-                         set<stmt_id> deleted_nodes,
-                         vector<vector<stmt_id>>& total_path,
-                         map<pair<stmt_id, stmt_id>, set<dependency_type>>& graph);
+    bool check_instrument(int tid, stmt_usage& stmt_u);
+    void process_op(vector<operate_unit>& op_list, int op_idx, int row_idx);
+    bool reach_committed(int from, int to, vector<bool>& visited);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <sys/time.h>
+
+#include "dut.hh"
+
+using namespace std;
+
+static unsigned long long get_cur_time_ms(void) {
+	struct timeval tv;
+	struct timezone tz;
+
+	gettimeofday(&tv, &tz);
+
+	return (tv.tv_sec * 1000ULL) + tv.tv_usec / 1000;
+}
+
+void wait_stmt_deadline(function<bool(void)> poll,
+                        function<bool(void)> is_blocked,
+                        function<bool(void)> kill_query,
+                        unsigned int block_check_ms,
+                        string session_name)
+{
+    auto begin_time = get_cur_time_ms();
+    auto deadline = begin_time + DUT_STMT_DEADLINE_MS;
+    bool killed = false;
+    while (1) {
+        if (poll())
+            break;
+
+        auto cur_time = get_cur_time_ms();
+        if (cur_time - begin_time >= block_check_ms) {
+            if (is_blocked())
+                throw runtime_error("blocked in " + session_name);
+            begin_time = cur_time;
+        }
+
+        // the killed statement returns an error, and it is skipped as other failed ones
+        if (cur_time >= deadline) {
+            if (killed || kill_query() == false)
+                throw runtime_error("SERVER_HANG: no answer after killing the statement of " + session_name);
+            cerr << "statement exceeds " << DUT_STMT_DEADLINE_MS << " ms, kill the statement of " << session_name << endl;
+            killed = true;
+            deadline = cur_time + DUT_KILL_WAIT_MS;
+        }
+    }
+}
+
+size_t batch_multi_statements(const vector<string>& stmts,
+                        vector<vector<vector<string>>>& outputs,
+                        vector<string>& errs,
+                        function<string(const string&)> send,
+                        function<string(vector<vector<string>>&)> store_result,
+                        function<bool(string&)> next_result,
+                        function<string(const string&)> stmt_error,
+                        function<bool(void)> stop)
+{
+    auto stmt_num = stmts.size();
+    outputs.assign(stmt_num, vector<vector<string>>());
+    errs.assign(stmt_num, "");
+
+    size_t next = 0;
+    while (next < stmt_num && !stop()) {
+        string batch_sql;
+        for (size_t i = next; i < stmt_num; i++)
+            batch_sql += stmts[i] + "\n";
+
+        auto cur = next;
+        auto err = send(batch_sql);
+        while (err == "") {
+            err = store_result(outputs[cur]);
+            if (err != "")
+                break;
+            cur++;
+            if (cur >= stmt_num || !next_result(err))
+                break;
+        }
+
+        if (err == "") {
+            next = cur;
+            continue;
+        }
+        if (err.find("Commands out of sync") != string::npos) { // occasionally happens, send the rest again
+            cerr << err << ", repeat the statements again" << endl;
+            next = cur;
+            continue;
+        }
+        errs[cur] = stmt_error(err);
+        next = cur + 1;
+    }
+    return next;
+}
@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <functional>
 
 #include "prod.hh"
 
@@ -45,6 +46,39 @@ struct syntax : failure {
 
 }
 
+// a statement running (not blocked) longer than the deadline gets killed, and if it
+// still does not return after the kill, the server is not answering (SERVER_HANG)
+#define DUT_STMT_DEADLINE_MS 10000
+#define DUT_KILL_WAIT_MS 5000
+// a server that does not answer a query in this time hangs, and is restarted
+#define DUT_ALIVE_TIMEOUT_S 5
+
+// wait for a statement sent without blocking, poll() returns true once it
+// returns. every block_check_ms, is_blocked() tells whether other sessions block
+// it (it throws "blocked"). after DUT_STMT_DEADLINE_MS the statement is killed
+// once with kill_query() (false: the server does not answer)
+void wait_stmt_deadline(function<bool(void)> poll,
+                        function<bool(void)> is_blocked,
+                        function<bool(void)> kill_query,
+                        unsigned int block_check_ms,
+                        string session_name);
+
+// the shared loop of test_batch for the duts speaking the mysql protocol. the rest
+// of the batch is sent as one multi-statement request with send(), and the result
+// of each statement is read in order with store_result() and next_result() (false:
+// no more results). the server stops at the first failed statement, so the rest is
+// sent again after it, and the loop stops early once stop() is true. the client calls
+// return the error ("" if they succeed), and stmt_error() turns the error of a
+// statement into its errs entry. returns the idx of the first statement not sent
+size_t batch_multi_statements(const vector<string>& stmts,
+                        vector<vector<vector<string>>>& outputs,
+                        vector<string>& errs,
+                        function<string(const string&)> send,
+                        function<string(vector<vector<string>>&)> store_result,
+                        function<bool(string&)> next_result,
+                        function<string(const string&)> stmt_error,
+                        function<bool(void)> stop);
+
 struct dut_base {
   std::string version;
   virtual void test(const string &stmt, vector<vector<string>>* output = NULL, int* affected_row_num = NULL) = 0;
@@ -58,6 +92,28 @@ struct dut_base {
   virtual string begin_stmt() = 0;
   
   virtual void get_content(vector<string>& tables_name, map<string, vector<vector<string>>>& content) = 0;
+
+  // execute the statements in order on this session. outputs[i] and errs[i]
+  // hold the result of stmts[i] ("" if it succeeds), where the error string
+  // is the what() of the exception test() would throw for it.
+  // the default one sends them one by one, a dut could pipeline them
+  virtual void test_batch(const vector<string>& stmts, vector<vector<vector<string>>>& outputs, vector<string>& errs) {
+    outputs.assign(stmts.size(), vector<vector<string>>());
+    errs.assign(stmts.size(), "");
+    test_rest(stmts, 0, outputs, errs);
+  }
+
+  // send stmts[begin...] one by one with test()
+  void test_rest(const vector<string>& stmts, size_t begin, vector<vector<vector<string>>>& outputs, vector<string>& errs) {
+    for (size_t i = begin; i < stmts.size(); i++) {
+      try {
+        test(stmts[i], &outputs[i]);
+      } catch (exception &e) {
+        outputs[i].clear();
+        errs[i] = e.what();
+      }
+    }
+  }
 };
 
 #endif
\ No newline at end of file
@@ -60,18 +60,35 @@ shared_ptr<schema> get_schema(dbms_info& d_info)
     return schema;
 }
 
+bool is_server_alive(dbms_info& d_info)
+{
+    if (false) {}
+    #ifdef HAVE_MYSQL
+    else if (d_info.dbms_name == "mysql")
+        return dut_mysql::is_server_alive(d_info.test_port);
+    #endif
+
+    #ifdef HAVE_MARIADB
+    else if (d_info.dbms_name == "mariadb")
+        return dut_mariadb::is_server_alive(d_info.test_port);
+    #endif
+
+    // the others are only checked by connecting
+    return true;
+}
+
 shared_ptr<dut_base> dut_setup(dbms_info& d_info)
 {
     shared_ptr<dut_base> dut;
     if (false) {}
     #ifdef HAVE_MYSQL
     else if (d_info.dbms_name == "mysql")
-        dut = make_shared<dut_mysql>(d_info.test_db, d_info.test_port);
+        dut = make_shared<dut_mysql>(d_info.test_db, d_info.test_port, d_info.session_isolation);
     #endif
 
     #ifdef HAVE_MARIADB
     else if (d_info.dbms_name == "mariadb")
-        dut = make_shared<dut_mariadb>(d_info.test_db, d_info.test_port);
+        dut = make_shared<dut_mariadb>(d_info.test_db, d_info.test_port, d_info.session_isolation);
     #endif
 
     #ifdef HAVE_TIDB
@@ -135,6 +152,27 @@ int use_backup_file(string backup_file, dbms_info& d_info)
     }
 }
 
+void save_session_level(string path, dbms_info& d_info)
+{
+    ofstream level_output(path);
+    level_output << d_info.session_level_name << endl;
+    level_output.close();
+}
+
+void use_session_level(string level_file, dbms_info& d_info)
+{
+    ifstream level_input(level_file);
+    string name;
+    level_input >> name;
+    level_input.close();
+    session_level level;
+    if (!get_session_level(d_info.dbms_name, name, level)) {
+        cerr << d_info.dbms_name << " does not support isolation level \"" << name << "\" in " << level_file << endl;
+        throw runtime_error("Unsupported isolation level");
+    }
+    d_info.set_session_level(level);
+}
+
 
 pid_t fork_db_server(dbms_info& d_info)
 {
@@ -306,25 +344,10 @@ void normal_test(dbms_info& d_info,
     }
 }
 
-static size_t BKDRHash(const char *str, size_t hash)  
+static void hash_output_to_set(vector<vector<string>> &output, vector<uint64_t>& hash_set)
 {
-    while (size_t ch = (size_t)*str++)  {         
-        hash = hash * 131 + ch;   // 也可以乘以31、131、1313、13131、131313..  
-    }  
-    return hash;  
-}
-
-static void hash_output_to_set(vector<vector<string>> &output, vector<size_t>& hash_set)
-{
-    size_t hash = 0;
-    auto row_size = output.size();
-    for (int i = 0; i < row_size; i++) {
-        auto column_size = output[i].size();
-        for (int j = 0; j < column_size; j++)
-            hash = BKDRHash(output[i][j].c_str(), hash);
-        hash_set.push_back(hash);
-        hash = 0;
-    }
+    for (auto& row : output)
+        hash_set.push_back(hash_row(row));
 
     // sort the set, because some output order is random
     sort(hash_set.begin(), hash_set.end());
@@ -426,7 +449,7 @@ bool compare_content(map<string, vector<vector<string>>>&a_content,
         nomoalize_content(con_table_content);
         nomoalize_content(seq_table_content);
 
-        vector<size_t> con_table_set, seq_table_set;
+        vector<uint64_t> con_table_set, seq_table_set;
         hash_output_to_set(con_table_content, con_table_set);
         hash_output_to_set(seq_table_content, seq_table_set);
 
@@ -465,7 +488,7 @@ bool compare_output(vector<vector<vector<string>>>& a_output,
         nomoalize_content(a_stmt_output);
         nomoalize_content(b_stmt_output);
         
-        vector<size_t> a_hash_set, b_hash_set;
+        vector<uint64_t> a_hash_set, b_hash_set;
         hash_output_to_set(a_stmt_output, a_hash_set);
         hash_output_to_set(b_stmt_output, b_hash_set);
 
@@ -789,6 +812,8 @@ bool minimize_testcase(dbms_info& d_info,
 
     save_current_testcase(stmt_queue, tid_queue, usage_queue, 
                             "min_stmts.sql", "min_tid.txt", "min_usage.txt");
+    if (!d_info.session_level_name.empty())
+        save_session_level("min_isolation.txt", d_info);
 
     return true;
 }
@@ -863,10 +888,13 @@ bool reproduce_routine(dbms_info& d_info,
         auto longest_stmt_path = tmp_da->topological_sort_path(empty_deleted_nodes, &delete_flag);
         if (delete_flag == true) {
             cerr << "the test case contains cycle and cannot be properly sorted" << endl;
+            graph_cycle_info cycle_info;
+            tmp_da->find_stmt_cycle((depend_mask)~0, cycle_info);
+            tmp_da->print_cycle_witness(cycle_info, true);
             return false;
         }
         cerr << RED << "stmt path for normal test: " << RESET;
-        print_stmt_path(longest_stmt_path, tmp_da->stmt_dependency_graph);
+        print_stmt_path(longest_stmt_path, *tmp_da);
 
         re_test.normal_stmt_test(longest_stmt_path);
         if (re_test.check_normal_stmt_result(longest_stmt_path, false) == false) {
@@ -1073,8 +1101,10 @@ void txn_decycle_test(dbms_info& d_info,
                 auto txn_stmt_num = re_test.trans_arr[txn_id].stmt_num;
                 for (int count = 0; count < txn_stmt_num; count++) {
                     auto s_id = stmt_id(txn_id, count);
-                    auto stmt_idx = s_id.transfer_2_stmt_idx(tid_queue);
-                    if (usage_queue[stmt_idx] == INIT_TYPE) // skip begin, commit, abort, SPACE_HOLDER_STMT
+                    auto stmt_idx = tmp_da->get_queue_idx(s_id); // in the executed queue
+                    if (stmt_idx == -1) // not executed
+                        continue;
+                    if (tmp_da->f_stmt_usage[stmt_idx] == INIT_TYPE) // skip begin, commit, abort, SPACE_HOLDER_STMT
                         continue;
                     txn_stmt_path.push_back(s_id);
                 }
@@ -1157,11 +1187,12 @@ void check_topo_sort(dbms_info& d_info,
         re_test.trans_test();
         shared_ptr<dependency_analyzer> tmp_da;
         re_test.analyze_txn_dependency(tmp_da);
-        auto all_topo_sort = tmp_da->get_all_topo_sort_path();
+        topo_sort_option option(TOPO_SORT_PATH_LIMIT, 0, true, thread::hardware_concurrency());
+        auto all_topo_sort = tmp_da->get_all_topo_sort_path(option);
 	cerr << "topo sort size: " << all_topo_sort.size() << endl;
         for (auto& sort : all_topo_sort) {
             cerr << RED << "stmt path for normal test: " << RESET;
-            print_stmt_path(sort, tmp_da->stmt_dependency_graph);
+            print_stmt_path(sort, *tmp_da);
 
             re_test.normal_stmt_output.clear();
             re_test.normal_stmt_err_info.clear();
@@ -8,6 +8,7 @@
 #include <dut.hh> // for dut_base
 #include <sys/stat.h> // for mkdir
 #include <algorithm> // for sort
+#include <thread> // for hardware_concurrency
 
 #include "config.h" // for PACKAGE_NAME
 
@@ -30,6 +31,7 @@
 #include "dbms_info.hh" // for dbms_info
 #include "transaction_test.hh" // for transaction
 #include "instrumentor.hh" // for stmt_usage
+#include "row_hash.hh" // for hash_row
 
 extern "C" { //for sigusr1
 #include <stdlib.h>
@@ -86,11 +88,16 @@ bool compare_content(map<string, vector<vector<string>>>&a_content,
                      map<string, vector<vector<string>>>&b_content);
 
 pid_t fork_db_server(dbms_info& d_info);
+// false: the server accepts no connection or does not answer a query in time
+bool is_server_alive(dbms_info& d_info);
 
 shared_ptr<schema> get_schema(dbms_info& d_info);
 shared_ptr<dut_base> dut_setup(dbms_info& d_info);
 int save_backup_file(string path, dbms_info& d_info);
 int use_backup_file(string backup_file, dbms_info& d_info);
+// the file keeps the short name of the session level (RC, RR, SER)
+void save_session_level(string path, dbms_info& d_info);
+void use_session_level(string level_file, dbms_info& d_info);
 
 void user_signal(int signal);
 
@@ -477,7 +477,7 @@ void schema_mariadb::update_schema()
     return;
 }
 
-dut_mariadb::dut_mariadb(string db, unsigned int port)
+dut_mariadb::dut_mariadb(string db, unsigned int port, string isolation)
   : mariadb_connection(db, port)
 {
     sent_sql = "";
@@ -485,16 +485,8 @@ dut_mariadb::dut_mariadb(string db, unsigned int port)
     query_status = 0;
     txn_abort = false;
     thread_id = mysql_thread_id(&mysql);
-    block_test("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ;");
-}
-
-static unsigned long long get_cur_time_ms(void) {
-	struct timeval tv;
-	struct timezone tz;
-
-	gettimeofday(&tv, &tz);
-
-	return (tv.tv_sec * 1000ULL) + tv.tv_usec / 1000;
+    if (!isolation.empty())
+        block_test("SET SESSION TRANSACTION ISOLATION LEVEL " + isolation + ";");
 }
 
 bool dut_mariadb::check_whether_block()
@@ -515,6 +507,58 @@ bool dut_mariadb::check_whether_block()
     return false;
 }
 
+// connect to the server, and give up connecting, reading or writing after timeout seconds
+static bool connect_with_timeout(MYSQL* conn, unsigned int port, unsigned int timeout)
+{
+    if (!mysql_init(conn))
+        return false;
+    mysql_options(conn, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+    mysql_options(conn, MYSQL_OPT_READ_TIMEOUT, &timeout);
+    mysql_options(conn, MYSQL_OPT_WRITE_TIMEOUT, &timeout);
+    if (mysql_real_connect(conn, "localhost", "root", NULL, NULL, port, NULL, 0))
+        return true;
+    cerr << "cannot connect to the server: " << mysql_error(conn) << endl;
+    mysql_close(conn);
+    return false;
+}
+
+// send KILL QUERY for the running statement of this connection through
+// another connection. false: the server does not answer
+bool dut_mariadb::kill_running_query()
+{
+    MYSQL killer;
+    if (!connect_with_timeout(&killer, 0, MYSQL_KILL_CONNECT_TIMEOUT_S))
+        return false;
+
+    bool answered = true;
+    string kill_sql = "KILL QUERY " + to_string(thread_id) + ";";
+    if (mysql_real_query(&killer, kill_sql.c_str(), kill_sql.size())) {
+        // "Unknown thread id" means the statement has finished in the meantime
+        string err = mysql_error(&killer);
+        if (regex_match(err, e_crash))
+            answered = false;
+    }
+    auto result = mysql_store_result(&killer);
+    mysql_free_result(result);
+    mysql_close(&killer);
+    return answered;
+}
+
+bool dut_mariadb::is_server_alive(unsigned int port)
+{
+    MYSQL conn;
+    if (!connect_with_timeout(&conn, port, DUT_ALIVE_TIMEOUT_S))
+        return false;
+    string alive_sql = "SELECT 1;";
+    bool answered = mysql_real_query(&conn, alive_sql.c_str(), alive_sql.size()) == 0;
+    if (!answered)
+        cerr << "no answer to " << alive_sql << ": " << mysql_error(&conn) << endl;
+    auto result = mysql_store_result(&conn);
+    mysql_free_result(result);
+    mysql_close(&conn);
+    return answered;
+}
+
 void dut_mariadb::block_test(const std::string &stmt, std::vector<std::string>* output, int* affected_row_num)
 {
     if (mysql_real_query(&mysql, stmt.c_str(), stmt.size())) {
@@ -566,6 +610,16 @@ void dut_mariadb::block_test(const std::string &stmt, std::vector<std::string>*
     return;
 }
 
+// keep calling the _cont function until the call finishes or fails. it throws
+// if the statement is blocked by other sessions or the server does not answer
+void dut_mariadb::wait_cont(function<int(void)> cont)
+{
+    wait_stmt_deadline([&]() { return cont() == 0 || mysql_errno(&mysql) != 0; },
+                        [&]() { return check_whether_block(); },
+                        [&]() { return kill_running_query(); },
+                        MYSQL_STMT_BLOCK_MS, "mariadb session " + to_string(thread_id));
+}
+
 void dut_mariadb::test(const string &stmt, vector<vector<string>>* output, int* affected_row_num)
 {
     int err;
@@ -594,35 +648,25 @@ void dut_mariadb::test(const string &stmt, vector<vector<string>>* output, int*
             "\nsent_sql: " + sent_sql +
             "\nstmt: " + stmt); 
 
-    auto begin_time = get_cur_time_ms();
-    while (1) {
+    wait_cont([&]() {
         query_status = mysql_real_query_cont(&err, &mysql, query_status);
-        if (mysql_errno(&mysql) != 0) {
-            string err = mysql_error(&mysql);
-            has_sent_sql = false;
-            sent_sql = "";
-            auto result = mysql_store_result(&mysql);
-            mysql_free_result(result);
+        return query_status;
+    });
+    if (mysql_errno(&mysql) != 0) {
+        string err = mysql_error(&mysql);
+        has_sent_sql = false;
+        sent_sql = "";
+        auto result = mysql_store_result(&mysql);
+        mysql_free_result(result);
 
-            if (err.find("Commands out of sync") != string::npos) {// occasionally happens, retry the statement again
-                // cerr << err << ", repeat the statement again" << endl;
-                test(stmt, output, affected_row_num);
-                return;
-            }
-            if (err.find("Deadlock found") != string::npos) 
-                txn_abort = true;
-            throw std::runtime_error("mysql_real_query_cont fails, stmt skipped: " + err + "\nLocation: " + debug_info); 
-        }
-        if (query_status == 0) 
-                break;
-        
-        auto cur_time = get_cur_time_ms();
-        if (cur_time - begin_time >= MYSQL_STMT_BLOCK_MS) {
-            auto blocked = check_whether_block();
-            if (blocked == true)
-                throw std::runtime_error("blocked in " + debug_info); 
-            begin_time = cur_time;
+        if (err.find("Commands out of sync") != string::npos) {// occasionally happens, retry the statement again
+            // cerr << err << ", repeat the statement again" << endl;
+            test(stmt, output, affected_row_num);
+            return;
         }
+        if (err.find("Deadlock found") != string::npos) 
+            txn_abort = true;
+        throw std::runtime_error("mysql_real_query_cont fails, stmt skipped: " + err + "\nLocation: " + debug_info); 
     }
 
     if (affected_row_num)
@@ -668,6 +712,67 @@ void dut_mariadb::test(const string &stmt, vector<vector<string>>* output, int*
     return;
 }
 
+// send the statements as one multi-statement request (see batch_multi_statements),
+// and the ones left after a deadlock through test(), which skips them
+void dut_mariadb::test_batch(const vector<string>& stmts, vector<vector<vector<string>>>& outputs, vector<string>& errs)
+{
+    mysql_set_server_option(&mysql, MYSQL_OPTION_MULTI_STATEMENTS_ON);
+    auto next = batch_multi_statements(stmts, outputs, errs,
+        [&](const string& sql) -> string {
+            int ret;
+            auto status = mysql_real_query_start(&ret, &mysql, sql.c_str(), sql.size());
+            if (status != 0 && mysql_errno(&mysql) == 0) {
+                wait_cont([&]() {
+                    status = mysql_real_query_cont(&ret, &mysql, status);
+                    return status;
+                });
+            }
+            return mysql_errno(&mysql) != 0 ? mysql_error(&mysql) : "";
+        },
+        [&](vector<vector<string>>& output) -> string {
+            auto result = mysql_store_result(&mysql);
+            if (mysql_errno(&mysql) != 0) {
+                string err = mysql_error(&mysql);
+                mysql_free_result(result);
+                return err;
+            }
+            if (result) {
+                auto column_num = mysql_num_fields(result);
+                while (auto row = mysql_fetch_row(result)) {
+                    vector<string> row_output;
+                    for (int i = 0; i < column_num; i++) 
+                        row_output.push_back(row[i] == NULL ? "NULL" : row[i]);
+                    output.push_back(row_output);
+                }
+            }
+            mysql_free_result(result);
+            return "";
+        },
+        [&](string& err) -> bool {
+            if (!mysql_more_results(&mysql))
+                return false;
+            int ret;
+            auto status = mysql_next_result_start(&ret, &mysql);
+            if (status != 0 && mysql_errno(&mysql) == 0) {
+                wait_cont([&]() {
+                    status = mysql_next_result_cont(&ret, &mysql, status);
+                    return status;
+                });
+            }
+            if (mysql_errno(&mysql) != 0)
+                err = mysql_error(&mysql);
+            return true;
+        },
+        [&](const string& err) -> string {
+            if (err.find("Deadlock found") != string::npos) 
+                txn_abort = true;
+            return "mysql_real_query_cont fails, stmt skipped: " + err + "\nLocation: " + debug_info;
+        },
+        [&]() { return txn_abort; }); // keep the skipping rules of test()
+    mysql_set_server_option(&mysql, MYSQL_OPTION_MULTI_STATEMENTS_OFF);
+    test_rest(stmts, next, outputs, errs);
+}
+
 void dut_mariadb::reset(void)
 {
     string drop_sql = "drop database if exists " + test_db + "; ";
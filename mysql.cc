@@ -472,23 +472,15 @@ void schema_mysql::update_schema()
     return;
 }
 
-dut_mysql::dut_mysql(string db, unsigned int port)
+dut_mysql::dut_mysql(string db, unsigned int port, string isolation)
   : mysql_connection(db, port)
 {
     sent_sql = "";
     has_sent_sql = false;
     txn_abort = false;
     thread_id = mysql_thread_id(&mysql);
-    block_test("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ;");
-}
-
-static unsigned long long get_cur_time_ms(void) {
-	struct timeval tv;
-	struct timezone tz;
-
-	gettimeofday(&tv, &tz);
-
-	return (tv.tv_sec * 1000ULL) + tv.tv_usec / 1000;
+    if (!isolation.empty())
+        block_test("SET SESSION TRANSACTION ISOLATION LEVEL " + isolation + ";");
 }
 
 bool dut_mysql::check_whether_block()
@@ -509,6 +501,70 @@ bool dut_mysql::check_whether_block()
     return false;
 }
 
+// connect to the server, and give up connecting, reading or writing after timeout seconds
+static bool connect_with_timeout(MYSQL* conn, unsigned int port, unsigned int timeout)
+{
+    if (!mysql_init(conn))
+        return false;
+    mysql_options(conn, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+    mysql_options(conn, MYSQL_OPT_READ_TIMEOUT, &timeout);
+    mysql_options(conn, MYSQL_OPT_WRITE_TIMEOUT, &timeout);
+    if (mysql_real_connect(conn, "127.0.0.1", "root", NULL, NULL, port, NULL, 0))
+        return true;
+    cerr << "cannot connect to the server: " << mysql_error(conn) << endl;
+    mysql_close(conn);
+    return false;
+}
+
+// send KILL QUERY for the running statement of this connection through
+// another connection. false: the server does not answer
+bool dut_mysql::kill_running_query()
+{
+    MYSQL killer;
+    if (!connect_with_timeout(&killer, test_port, MYSQL_KILL_CONNECT_TIMEOUT_S))
+        return false;
+
+    bool answered = true;
+    string kill_sql = "KILL QUERY " + to_string(thread_id) + ";";
+    if (mysql_real_query(&killer, kill_sql.c_str(), kill_sql.size())) {
+        // "Unknown thread id" means the statement has finished in the meantime
+        string err = mysql_error(&killer);
+        if (regex_match(err, e_crash))
+            answered = false;
+    }
+    auto result = mysql_store_result(&killer);
+    mysql_free_result(result);
+    mysql_close(&killer);
+    return answered;
+}
+
+bool dut_mysql::is_server_alive(unsigned int port)
+{
+    MYSQL conn;
+    if (!connect_with_timeout(&conn, port, DUT_ALIVE_TIMEOUT_S))
+        return false;
+    string alive_sql = "SELECT 1;";
+    bool answered = mysql_real_query(&conn, alive_sql.c_str(), alive_sql.size()) == 0;
+    if (!answered)
+        cerr << "no answer to " << alive_sql << ": " << mysql_error(&conn) << endl;
+    auto result = mysql_store_result(&conn);
+    mysql_free_result(result);
+    mysql_close(&conn);
+    return answered;
+}
+
+// poll the nonblocking call until it is not NET_ASYNC_NOT_READY. it throws
+// if the statement is blocked by other sessions or the server does not answer
+net_async_status dut_mysql::wait_nonblocking(function<net_async_status(void)> poll)
+{
+    net_async_status status;
+    wait_stmt_deadline([&]() { status = poll(); return status != NET_ASYNC_NOT_READY; },
+                        [&]() { return check_whether_block(); },
+                        [&]() { return kill_running_query(); },
+                        MYSQL_STMT_BLOCK_MS, "mysql session " + to_string(thread_id));
+    return status;
+}
+
 void dut_mysql::block_test(const std::string &stmt, std::vector<std::string>* output, int* affected_row_num)
 {
     if (mysql_real_query(&mysql, stmt.c_str(), stmt.size())) {
@@ -586,20 +642,9 @@ void dut_mysql::test(const string &stmt, vector<vector<string>>* output, int* af
             "\nsent_sql: " + sent_sql +
             "\nstmt: " + stmt); 
 
-    auto begin_time = get_cur_time_ms();
-    while (1) {
-        status = mysql_real_query_nonblocking(&mysql, stmt.c_str(), stmt.size());
-        if (status != NET_ASYNC_NOT_READY)
-            break;
-            
-        auto cur_time = get_cur_time_ms();
-        if (cur_time - begin_time >= MYSQL_STMT_BLOCK_MS) {
-            auto blocked = check_whether_block();
-            if (blocked == true)
-                throw std::runtime_error("blocked in " + debug_info); 
-            begin_time = cur_time;
-        }
-    }
+    status = wait_nonblocking([&]() {
+        return mysql_real_query_nonblocking(&mysql, stmt.c_str(), stmt.size());
+    });
 
     if (status == NET_ASYNC_ERROR) {
         string err = mysql_error(&mysql);
@@ -662,6 +707,59 @@ void dut_mysql::test(const string &stmt, vector<vector<string>>* output, int* af
     return;
 }
 
+// send the statements as one multi-statement request (see batch_multi_statements),
+// and the ones left after a deadlock through test(), which skips them
+void dut_mysql::test_batch(const vector<string>& stmts, vector<vector<vector<string>>>& outputs, vector<string>& errs)
+{
+    mysql_set_server_option(&mysql, MYSQL_OPTION_MULTI_STATEMENTS_ON);
+    auto next = batch_multi_statements(stmts, outputs, errs,
+        [&](const string& sql) -> string {
+            auto clear_results = mysql_store_result(&mysql);
+            mysql_free_result(clear_results);
+            auto status = wait_nonblocking([&]() {
+                return mysql_real_query_nonblocking(&mysql, sql.c_str(), sql.size());
+            });
+            return status == NET_ASYNC_ERROR ? mysql_error(&mysql) : "";
+        },
+        [&](vector<vector<string>>& output) -> string {
+            auto result = mysql_store_result(&mysql);
+            if (mysql_errno(&mysql) != 0) {
+                string err = mysql_error(&mysql);
+                mysql_free_result(result);
+                return err;
+            }
+            if (result) {
+                auto column_num = mysql_num_fields(result);
+                while (auto row = mysql_fetch_row(result)) {
+                    vector<string> row_output;
+                    for (int i = 0; i < column_num; i++) 
+                        row_output.push_back(row[i] == NULL ? "NULL" : row[i]);
+                    output.push_back(row_output);
+                }
+            }
+            mysql_free_result(result);
+            return "";
+        },
+        [&](string& err) -> bool {
+            if (!mysql_more_results(&mysql))
+                return false;
+            auto status = wait_nonblocking([&]() {
+                return mysql_next_result_nonblocking(&mysql);
+            });
+            if (status == NET_ASYNC_ERROR)
+                err = mysql_error(&mysql);
+            return true;
+        },
+        [&](const string& err) -> string {
+            if (err.find("Deadlock found") != string::npos) 
+                txn_abort = true;
+            return "NET_ASYNC_ERROR(skipped): " + err + "\nLocation: " + debug_info;
+        },
+        [&]() { return txn_abort; }); // keep the skipping rules of test()
+    mysql_set_server_option(&mysql, MYSQL_OPTION_MULTI_STATEMENTS_OFF);
+    test_rest(stmts, next, outputs, errs);
+}
+
 void dut_mysql::reset(void)
 {
     string drop_sql = "drop database if exists " + test_db + "; ";
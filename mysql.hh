@@ -10,8 +10,10 @@ extern "C"  {
 #include "dut.hh"
 
 #include <sys/time.h> // for gettimeofday
+#include <functional>
 
 #define MYSQL_STMT_BLOCK_MS 100
+#define MYSQL_KILL_CONNECT_TIMEOUT_S 5
 
 struct mysql_connection {
     MYSQL mysql;
@@ -31,6 +33,7 @@ struct schema_mysql : schema, mysql_connection {
 
 struct dut_mysql : dut_base, mysql_connection {
     virtual void test(const string &stmt, vector<vector<string>>* output = NULL, int* affected_row_num = NULL);
+    virtual void test_batch(const vector<string>& stmts, vector<vector<vector<string>>>& outputs, vector<string>& errs);
     virtual void reset(void);
 
     virtual void backup(void);
@@ -41,15 +44,20 @@ struct dut_mysql : dut_base, mysql_connection {
     virtual string begin_stmt();
 
     static pid_t fork_db_server();
+    // false: the server does not answer a query in DUT_ALIVE_TIMEOUT_S
+    static bool is_server_alive(unsigned int port);
     
     virtual void get_content(vector<string>& tables_name, map<string, vector<vector<string>>>& content);
-    dut_mysql(string db, unsigned int port);
+    // isolation: sql name of the session level, empty: the server default
+    dut_mysql(string db, unsigned int port, string isolation = "REPEATABLE READ");
 
     static int save_backup_file(string path);
     static int use_backup_file(string backup_file);
     
     void block_test(const std::string &stmt, std::vector<std::string>* output = NULL, int* affected_row_num = NULL);
     bool check_whether_block();
+    bool kill_running_query();
+    net_async_status wait_nonblocking(function<net_async_status(void)> poll);
     bool has_sent_sql;
     string sent_sql;
     bool txn_abort;
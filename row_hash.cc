@@ -0,0 +1,78 @@
+#include "row_hash.hh"
+
+#include <cstring>
+
+#define ROW_HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define ROW_HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define ROW_HASH_PRIME3 0x165667B19E3779F9ULL
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t hash_round(uint64_t acc, uint64_t word)
+{
+    acc += word * ROW_HASH_PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * ROW_HASH_PRIME1;
+}
+
+uint64_t hash_row(const vector<string>& row)
+{
+    uint64_t hash = ROW_HASH_PRIME3 ^ row.size();
+    for (auto& field : row) {
+        auto data = field.data();
+        auto len = field.size();
+        hash = hash_round(hash, len);
+        size_t pos = 0;
+        for (; pos + 8 <= len; pos += 8) {
+            uint64_t word;
+            memcpy(&word, data + pos, 8);
+            hash = hash_round(hash, word);
+        }
+        if (pos < len) {
+            uint64_t word = 0;
+            memcpy(&word, data + pos, len - pos);
+            hash = hash_round(hash, word);
+        }
+    }
+    // avalanche
+    hash ^= hash >> 33;
+    hash *= ROW_HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= ROW_HASH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+int row_interner::intern(const vector<string>& row)
+{
+    auto hash = hash_row(row);
+    auto iter = hash_to_id.find(hash);
+    if (iter == hash_to_id.end()) {
+        int id = rows.size();
+        rows.push_back(row);
+        same_hash_next.push_back(-1);
+        hash_to_id[hash] = id;
+        return id;
+    }
+    int last = -1;
+    for (int id = iter->second; id != -1; id = same_hash_next[id]) {
+        if (rows[id] == row)
+            return id;
+        last = id;
+    }
+    int id = rows.size();
+    rows.push_back(row);
+    same_hash_next.push_back(-1);
+    same_hash_next[last] = id;
+    return id;
+}
+
+void row_interner::clear()
+{
+    rows.clear();
+    same_hash_next.clear();
+    hash_to_id.clear();
+}
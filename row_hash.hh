@@ -0,0 +1,29 @@
+#ifndef ROW_HASH_HH
+#define ROW_HASH_HH
+
+#include "config.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace std;
+
+// 64-bit hash of a row, 8 bytes per step. The length of each field is mixed
+// in, so that ("a", "bc") and ("ab", "c") are different rows
+uint64_t hash_row(const vector<string>& row);
+
+// each distinct row is stored once and referenced by its id, two rows are the
+// same iff their ids are the same (hash collisions are resolved by comparing)
+struct row_interner {
+    deque<vector<string>> rows; // id -> row, deque keeps the rows in place
+    vector<int> same_hash_next; // id -> next id having the same hash, -1 for none
+    unordered_map<uint64_t, int> hash_to_id; // hash -> first id
+
+    int intern(const vector<string>& row);
+    const vector<string>& get(int id) const { return rows[id]; }
+    void clear();
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "schedule_filter.hh"
+
+#include <iostream>
+#include <cctype>
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+}
+
+#define FNV_PRIME 1099511628211ULL
+
+static unsigned long long fnv1a_hash(const string& str, unsigned long long hash)
+{
+    for (auto ch : str) {
+        hash ^= (unsigned char)ch;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static bool is_ident_char(char ch)
+{
+    return isalnum((unsigned char)ch) || ch == '_';
+}
+
+string normalize_stmt_template(const string& stmt)
+{
+    string res;
+    auto len = stmt.size();
+    size_t i = 0;
+    while (i < len) {
+        auto ch = stmt[i];
+        if (ch == '\'') { // string literal, '' is an escaped quote
+            i++;
+            while (i < len) {
+                if (stmt[i] == '\'' && i + 1 < len && stmt[i + 1] == '\'') {
+                    i += 2;
+                    continue;
+                }
+                if (stmt[i] == '\'')
+                    break;
+                i++;
+            }
+            i++;
+            res += "?";
+            continue;
+        }
+        if (isdigit((unsigned char)ch) && (res.empty() || !is_ident_char(res.back()))) {
+            while (i < len && (isdigit((unsigned char)stmt[i]) || stmt[i] == '.' ||
+                        stmt[i] == 'e' || stmt[i] == 'E'))
+                i++;
+            res += "?";
+            continue;
+        }
+        res += ch;
+        i++;
+    }
+    return res;
+}
+
+bool schedule_filter::test_and_insert(const string& fingerprint)
+{
+    // double hashing: the k-th bit is h1 + k * h2
+    auto h1 = fnv1a_hash(fingerprint, 14695981039346656037ULL);
+    auto h2 = fnv1a_hash(fingerprint, 1469598103934665603ULL) | 1;
+
+    int fd = open(file_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        cerr << "schedule_filter: cannot open " << file_path << ", skip dedup" << endl;
+        return false;
+    }
+    if (flock(fd, LOCK_EX) != 0) {
+        cerr << "schedule_filter: cannot lock " << file_path << ", skip dedup" << endl;
+        close(fd);
+        return false;
+    }
+    if (lseek(fd, 0, SEEK_END) < SCHEDULE_FILTER_BITS / 8 &&
+            ftruncate(fd, SCHEDULE_FILTER_BITS / 8) != 0) {
+        cerr << "schedule_filter: cannot resize " << file_path << ", skip dedup" << endl;
+        flock(fd, LOCK_UN);
+        close(fd);
+        return false;
+    }
+
+    bool all_set = true;
+    for (int k = 0; k < SCHEDULE_FILTER_HASH_NUM; k++) {
+        auto bit = (h1 + k * h2) % SCHEDULE_FILTER_BITS;
+        unsigned char byte = 0;
+        if (pread(fd, &byte, 1, bit / 8) != 1)
+            byte = 0;
+        unsigned char mask = 1 << (bit % 8);
+        if (byte & mask)
+            continue;
+        all_set = false;
+        byte |= mask;
+        if (pwrite(fd, &byte, 1, bit / 8) != 1)
+            cerr << "schedule_filter: cannot write " << file_path << endl;
+    }
+
+    flock(fd, LOCK_UN);
+    close(fd);
+    return all_set;
+}
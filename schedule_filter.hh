@@ -0,0 +1,29 @@
+#ifndef SCHEDULE_FILTER_HH
+#define SCHEDULE_FILTER_HH
+
+#include "config.h"
+#include <string>
+
+using namespace std;
+
+// on-disk bloom filter of already tested schedules, shared by all the
+// forked test processes (access is serialized with flock)
+#define SCHEDULE_FILTER_FILE "schedule_filter.bin"
+#define SCHEDULE_FILTER_BITS (1 << 23) // 1MB on disk, ~0.1% false positive for 500k schedules
+#define SCHEDULE_FILTER_HASH_NUM 7
+
+struct schedule_filter {
+    string file_path;
+
+    schedule_filter(string path = SCHEDULE_FILTER_FILE) : file_path(path) {}
+
+    // true: the fingerprint (probably) has been inserted before
+    // false: it is a new one, and it is inserted now
+    bool test_and_insert(const string& fingerprint);
+};
+
+// replace numeric and string literals with "?", so that statements
+// generated from the same template share the same string
+string normalize_stmt_template(const string& stmt);
+
+#endif
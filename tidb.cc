@@ -542,6 +542,53 @@ void dut_tidb::test(const std::string &stmt, vector<vector<string>>* output, int
     mysql_free_result(result);
 }
 
+// send the statements as one multi-statement request (see batch_multi_statements).
+// once the server crashes, the rest cannot be executed either
+void dut_tidb::test_batch(const vector<string>& stmts, vector<vector<vector<string>>>& outputs, vector<string>& errs)
+{
+    string crash_err;
+    mysql_set_server_option(&mysql, MYSQL_OPTION_MULTI_STATEMENTS_ON);
+    auto next = batch_multi_statements(stmts, outputs, errs,
+        [&](const string& sql) -> string {
+            auto clear_results = mysql_store_result(&mysql);
+            mysql_free_result(clear_results);
+            if (mysql_real_query(&mysql, sql.c_str(), sql.size())) 
+                return mysql_error(&mysql);
+            return "";
+        },
+        [&](vector<vector<string>>& output) -> string {
+            auto result = mysql_store_result(&mysql);
+            if (result) {
+                auto column_num = mysql_num_fields(result);
+                while (auto row = mysql_fetch_row(result)) {
+                    vector<string> row_output;
+                    for (int i = 0; i < column_num; i++) 
+                        row_output.push_back(row[i] == NULL ? "NULL" : row[i]);
+                    output.push_back(row_output);
+                }
+            }
+            mysql_free_result(result);
+            return "";
+        },
+        [&](string& err) -> bool {
+            auto ret = mysql_next_result(&mysql);
+            if (ret > 0) 
+                err = mysql_error(&mysql);
+            return ret >= 0; // < 0: no more results
+        },
+        [&](const string& err) -> string {
+            if (regex_match(err, e_crash)) {
+                crash_err = err;
+                return "BUG!!! " + err + " in mysql::test";
+            }
+            return err + " in mysql::test";
+        },
+        [&]() { return crash_err != ""; });
+    mysql_set_server_option(&mysql, MYSQL_OPTION_MULTI_STATEMENTS_OFF);
+    for (; next < stmts.size(); next++)
+        errs[next] = "BUG!!! " + crash_err + " in mysql::test";
+}
+
 void dut_tidb::reset(void)
 {
     string drop_sql = "drop database if exists " + test_db + "; ";
@@ -30,6 +30,7 @@ struct schema_tidb : schema, tidb_connection {
 
 struct dut_tidb : dut_base, tidb_connection {
     virtual void test(const std::string &stmt, vector<vector<string>>* output = NULL, int* affected_row_num = NULL);
+    virtual void test_batch(const vector<string>& stmts, vector<vector<vector<string>>>& outputs, vector<string>& errs);
     virtual void reset(void);
 
     virtual void backup(void);
@@ -0,0 +1,160 @@
+#include "trace.hh"
+
+#include <fstream>
+
+static void write_string(ostream& out, const string& str)
+{
+    out << str.size() << ":" << str;
+}
+
+static void read_string(istream& in, string& str)
+{
+    size_t len;
+    char colon;
+    if (!(in >> len) || !in.get(colon) || colon != ':')
+        throw runtime_error("read_trace: broken string");
+    str.resize(len);
+    if (len > 0 && !in.read(&str[0], len))
+        throw runtime_error("read_trace: truncated string");
+}
+
+static void write_output(ostream& out, const stmt_output& output)
+{
+    out << output.size() << "\n";
+    for (auto& row : output) {
+        out << row.size();
+        for (auto& field : row) {
+            out << " ";
+            write_string(out, field);
+        }
+        out << "\n";
+    }
+}
+
+static void read_output(istream& in, stmt_output& output)
+{
+    int row_num;
+    if (!(in >> row_num) || row_num < 0)
+        throw runtime_error("read_trace: broken output");
+    output.resize(row_num);
+    for (auto& row : output) {
+        int field_num;
+        if (!(in >> field_num) || field_num < 0)
+            throw runtime_error("read_trace: broken row");
+        row.resize(field_num);
+        for (auto& field : row)
+            read_string(in, field);
+    }
+}
+
+static void expect_word(istream& in, const string& word)
+{
+    string got;
+    if (!(in >> got) || got != word)
+        throw runtime_error("read_trace: expect " + word + ", but got " + got);
+}
+
+void write_trace(ostream& out, txn_trace& trace)
+{
+    out << TRACE_MAGIC << " " << TRACE_VERSION << "\n";
+    out << "isolation " << isolation_name(trace.isolation) << "\n";
+    out << "txn " << trace.t_num;
+    for (auto status : trace.txn_status_queue)
+        out << " " << status;
+    out << "\n";
+
+    out << "init " << trace.init_output.size() << "\n";
+    for (auto& output : trace.init_output)
+        write_output(out, output);
+
+    auto stmt_num = trace.tid_queue.size();
+    out << "stmt " << stmt_num << "\n";
+    for (int i = 0; i < stmt_num; i++) {
+        auto& usage = trace.usage_queue[i];
+        out << trace.tid_queue[i] << " " << usage.stmt_type << " " << usage.is_instrumented << " ";
+        write_string(out, usage.target_table);
+        out << " ";
+        write_string(out, i < trace.stmts.size() ? trace.stmts[i] : string());
+        out << "\n";
+        write_output(out, *trace.output_queue[i]);
+    }
+}
+
+void save_trace(string path, txn_trace& trace)
+{
+    ofstream out(path);
+    if (!out)
+        throw runtime_error("save_trace: cannot open " + path);
+    write_trace(out, trace);
+}
+
+void read_trace(istream& in, txn_trace& trace)
+{
+    int version;
+    expect_word(in, TRACE_MAGIC);
+    if (!(in >> version) || version != TRACE_VERSION)
+        throw runtime_error("read_trace: unknown version");
+
+    string level_name;
+    expect_word(in, "isolation");
+    in >> level_name;
+    bool known_level = false;
+    for (int level = PL_2; level <= PL_3; level++) {
+        if (isolation_name((isolation_level)level) != level_name)
+            continue;
+        trace.isolation = (isolation_level)level;
+        known_level = true;
+    }
+    if (!known_level)
+        throw runtime_error("read_trace: unknown isolation level " + level_name);
+
+    expect_word(in, "txn");
+    if (!(in >> trace.t_num) || trace.t_num < 0)
+        throw runtime_error("read_trace: broken txn num");
+    trace.txn_status_queue.resize(trace.t_num);
+    for (auto& status : trace.txn_status_queue) {
+        int status_val;
+        if (!(in >> status_val))
+            throw runtime_error("read_trace: broken txn status");
+        status = (txn_status)status_val;
+    }
+
+    int table_num;
+    expect_word(in, "init");
+    if (!(in >> table_num) || table_num < 0)
+        throw runtime_error("read_trace: broken init content");
+    trace.init_output.resize(table_num);
+    for (auto& output : trace.init_output)
+        read_output(in, output);
+
+    int stmt_num;
+    expect_word(in, "stmt");
+    if (!(in >> stmt_num) || stmt_num < 0)
+        throw runtime_error("read_trace: broken stmt num");
+    trace.stmts.resize(stmt_num);
+    trace.tid_queue.resize(stmt_num);
+    trace.usage_queue.clear();
+    trace.output_queue.clear();
+    for (int i = 0; i < stmt_num; i++) {
+        int stmt_type;
+        bool is_instrumented;
+        string target_table;
+        if (!(in >> trace.tid_queue[i] >> stmt_type >> is_instrumented))
+            throw runtime_error("read_trace: broken stmt " + to_string(i));
+        read_string(in, target_table);
+        read_string(in, trace.stmts[i]);
+        trace.usage_queue.push_back(stmt_usage((stmt_basic_type)stmt_type, is_instrumented, target_table));
+
+        auto output = make_shared<stmt_output>();
+        read_output(in, *output);
+        trace.output_queue.push_back(output);
+    }
+}
+
+void load_trace(string path, txn_trace& trace)
+{
+    ifstream in(path);
+    if (!in)
+        throw runtime_error("load_trace: cannot open " + path);
+    read_trace(in, trace);
+}
@@ -0,0 +1,37 @@
+#ifndef TRACE_HH
+#define TRACE_HH
+
+#include "config.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include "dependency_analyzer.hh"
+
+using namespace std;
+
+#define TRACE_MAGIC "txcheck-trace"
+#define TRACE_VERSION 1
+
+// a recorded execution with everything dependency_analyzer needs, so that the
+// oracles can be re-run offline (txcheck-analyze) without a dbms
+struct txn_trace {
+    isolation_level isolation; // the level the dbms was tested with
+    int t_num;
+    vector<txn_status> txn_status_queue; // [tid]
+    vector<stmt_output> init_output; // content of each table before the test
+    // the executed stmts in the real order
+    vector<string> stmts;
+    vector<int> tid_queue;
+    vector<stmt_usage> usage_queue;
+    vector<stmt_output_ref> output_queue;
+};
+
+// strings are written as <length>:<bytes>, so that any field (with spaces or
+// newlines) can be read back exactly
+void write_trace(ostream& out, txn_trace& trace);
+void save_trace(string path, txn_trace& trace);
+// throw runtime_error if the trace is broken
+void read_trace(istream& in, txn_trace& trace);
+void load_trace(string path, txn_trace& trace);
+
+#endif
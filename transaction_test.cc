@@ -84,6 +84,46 @@ void transaction_test::gen_txn_stmts()
     cerr << "done" << endl;
 }
 
+// canonical form of the generated test case: the database schema, the
+// normalized statement templates of each transaction and the interleaving
+// pattern. Transaction ids are renamed by their first appearance in
+// tid_queue, so that schedules only differ in tid labels are the same.
+string transaction_test::schedule_fingerprint()
+{
+    // the same schedule is checked differently on another dbms or level
+    string fingerprint = test_dbms_info.dbms_name + " " + test_dbms_info.session_isolation;
+    for (auto& level : test_dbms_info.oracle_levels)
+        fingerprint += " " + level.sql_name;
+    fingerprint += "\n";
+    for (auto& t : db_schema->tables) {
+        fingerprint += t.ident() + "(";
+        for (auto& c : t.columns())
+            fingerprint += c.name + " " + c.type->name + ",";
+        fingerprint += ")\n";
+    }
+
+    vector<int> canonical_tid(trans_num, -1);
+    int next_tid = 0;
+    for (auto tid : tid_queue) {
+        if (canonical_tid[tid] == -1)
+            canonical_tid[tid] = next_tid++;
+        fingerprint += to_string(canonical_tid[tid]) + " ";
+    }
+    fingerprint += "\n";
+
+    vector<int> tid_of_canonical(next_tid);
+    for (int tid = 0; tid < trans_num; tid++) {
+        if (canonical_tid[tid] != -1)
+            tid_of_canonical[canonical_tid[tid]] = tid;
+    }
+    for (auto tid : tid_of_canonical) {
+        fingerprint += to_string(trans_arr[tid].status) + ":";
+        for (auto& stmt : trans_arr[tid].stmts)
+            fingerprint += normalize_stmt_template(print_stmt_to_string(stmt)) + "\n";
+    }
+    return fingerprint;
+}
+
 // instrument, and also align the trans_arr[tid] related data
 void transaction_test::instrument_txn_stmts()
 {
@@ -183,52 +223,140 @@ bool transaction_test::change_txn_status(int target_tid, txn_status final_status
     return true;
 }
 
-bool transaction_test::analyze_txn_dependency(shared_ptr<dependency_analyzer>& da)
+void transaction_test::get_execution_input(vector<stmt_output>& init_output, vector<txn_status>& real_txn_status)
 {
-    vector<stmt_output> init_content_vector;
+    init_output.clear();
     for (auto iter = init_db_content.begin(); iter != init_db_content.end(); iter++)
-        init_content_vector.push_back(iter->second);
+        init_output.push_back(iter->second);
     
-    vector<txn_status> real_txn_status;
+    real_txn_status.clear();
     for (int tid = 0; tid < trans_num; tid++) 
         real_txn_status.push_back(trans_arr[tid].status);
+}
 
-    da = make_shared<dependency_analyzer>(init_content_vector, // init_output 
-                            real_output_queue, // total_output
-                            real_tid_queue, // final_tid_queue
-                            real_stmt_usage, // final_stmt_usage
-                            real_txn_status, // final_txn_status
-                            trans_num, // t_num
-                            1, // primary_key_idx
-                            0); // write_op_key_idx
+bool transaction_test::analyze_txn_dependency(shared_ptr<dependency_analyzer>& da)
+{
+    vector<stmt_output> init_content_vector;
+    vector<txn_status> real_txn_status;
+    get_execution_input(init_content_vector, real_txn_status);
+    
+    if (!trace_dir.empty())
+        record_trace(init_content_vector, real_txn_status);
+
+    if (da == NULL)
+        da = make_shared<dependency_analyzer>();
+    da->reset(init_content_vector, // init_output 
+                real_output_queue, // total_output
+                real_tid_queue, // final_tid_queue
+                real_stmt_usage, // final_stmt_usage
+                real_txn_status, // final_txn_status
+                trans_num, // t_num
+                1, // primary_key_idx
+                0); // write_op_key_idx
 
     cerr << "check transaction dependency ... ";
-    if (da->check_G1a() == true) {
-        cerr << "check_G1a violate!!" << endl;
+    if (da->check_isolation(test_dbms_info.isolation) == true)
         return true;
-    }
-    if (da->check_G1b() == true){
-        cerr << "check_G1b violate!!" << endl;
+    cerr << "done" << endl;
+
+    return false;
+}
+
+// an execution observed in multi_level_test, and the analyzer built from it
+struct level_history {
+    vector<stmt_output> init_output;
+    vector<int> tid_queue;
+    vector<stmt_usage> stmt_usage_queue;
+    vector<stmt_output_ref> output_queue;
+    vector<txn_status> txn_status_queue;
+    shared_ptr<dependency_analyzer> da;
+    string first_level; // the level observing it first
+
+    bool operator==(const level_history& other) const {
+        if (init_output != other.init_output || tid_queue != other.tid_queue || 
+                txn_status_queue != other.txn_status_queue || output_queue.size() != other.output_queue.size())
+            return false;
+        for (int i = 0; i < stmt_usage_queue.size(); i++) {
+            if (stmt_usage_queue[i] != other.stmt_usage_queue[i] || 
+                    stmt_usage_queue[i].is_instrumented != other.stmt_usage_queue[i].is_instrumented)
+                return false;
+        }
+        for (int i = 0; i < output_queue.size(); i++) {
+            if (output_queue[i] != other.output_queue[i] && *output_queue[i] != *other.output_queue[i])
+                return false;
+        }
         return true;
     }
-    if (da->check_G1c() == true){
-        cerr << "check_G1c violate!!" << endl;
-        return true;
+};
+
+bool transaction_test::multi_level_test()
+{
+    auto default_dbms_info = test_dbms_info;
+    auto init_stmt_queue = stmt_queue;
+    auto init_tid_queue = tid_queue;
+    auto init_stmt_usage = stmt_use;
+    vector<txn_status> init_txn_status;
+    vector<vector<shared_ptr<prod>>> init_txn_stmt;
+    for (int tid = 0; tid < trans_num; tid++) {
+        init_txn_status.push_back(trans_arr[tid].status);
+        init_txn_stmt.push_back(trans_arr[tid].stmts);
     }
-    // if (da->check_G2_item() == true){
-    //     cerr << "check_G2_item violate!!" << endl;
-    //     return true;
-    // }
-    // if (da->check_GSIa() == true){
-    //     cerr << "check_GSIa violate!!" << endl;
-    //     return true;
-    // }
-    // if (da->check_GSIb() == true){
-    //     cerr << "check_GSIb violate!!" << endl;
-    //     return true;
-    // }
-    cerr << "done" << endl;
 
+    // trans_test() turns a failed commit into an abort, so every level starts
+    // from the generated schedule again
+    auto restore_schedule = [&]() {
+        stmt_queue = init_stmt_queue;
+        stmt_use = init_stmt_usage;
+        tid_queue = init_tid_queue;
+        for (int tid = 0; tid < trans_num; tid++) {
+            trans_arr[tid].stmts = init_txn_stmt[tid];
+            change_txn_status(tid, init_txn_status[tid]);
+        }
+    };
+
+    vector<level_history> histories;
+    bool violated = false;
+    for (auto& level : default_dbms_info.oracle_levels) {
+        test_dbms_info.set_session_level(level);
+        cerr << "isolation level " << level.name << " (" << isolation_name(level.guarantee) << ") ... ";
+        restore_schedule();
+        clear_execution_status();
+        trans_test(false, true);
+
+        level_history observed;
+        get_execution_input(observed.init_output, observed.txn_status_queue);
+        observed.tid_queue = real_tid_queue;
+        observed.stmt_usage_queue = real_stmt_usage;
+        observed.output_queue = real_output_queue;
+        if (!trace_dir.empty())
+            record_trace(observed.init_output, observed.txn_status_queue);
+
+        // the graphs of a history are built once, each level only runs its checks
+        auto same_it = find(histories.begin(), histories.end(), observed);
+        if (same_it == histories.end()) {
+            observed.first_level = level.name;
+            observed.da = make_shared<dependency_analyzer>();
+            observed.da->reset(observed.init_output, observed.output_queue, observed.tid_queue, 
+                                observed.stmt_usage_queue, observed.txn_status_queue, trans_num, 1, 0);
+            histories.push_back(observed);
+            same_it = histories.end() - 1;
+        } else {
+            cerr << "same history as level " << same_it->first_level << ", ";
+        }
+        if (same_it->da->check_isolation(level.guarantee)) {
+            cerr << RED << "violated at isolation level " << level.name << RESET << endl;
+            violated = true;
+            break;
+        }
+        cerr << "done" << endl;
+    }
+    if (violated) // keep the violating level in test_dbms_info for the bug record
+        return true;
+
+    test_dbms_info = default_dbms_info;
+    clear_execution_status();
+    restore_schedule();
+    cerr << histories.size() << " distinct histories at " << default_dbms_info.oracle_levels.size() << " isolation levels" << endl;
     return false;
 }
 
@@ -263,7 +391,7 @@ void transaction_test::clear_execution_status()
 //    Note: for the unacceptable error, implemented dbms front-end should throw error containing "skipped"
 // 1: executed
 // 0: blocked, not executed
-int transaction_test::trans_test_unit(int stmt_pos, stmt_output& output, bool debug_mode)
+int transaction_test::trans_test_unit(int stmt_pos, stmt_output_ref& output, bool debug_mode)
 {
     auto tid = tid_queue[stmt_pos];
     auto stmt = print_stmt_to_string(stmt_queue[stmt_pos]);
@@ -272,7 +400,9 @@ int transaction_test::trans_test_unit(int stmt_pos, stmt_output& output, bool de
     replace(show_str.begin(), show_str.end(), '\n', ' ');
     
     try {
-        trans_arr[tid].dut->test(stmt, &output);
+        auto result = make_shared<stmt_output>(); // filled once, then only shared
+        trans_arr[tid].dut->test(stmt, result.get());
+        output = result;
         trans_arr[tid].stmt_outputs.push_back(output);
         trans_arr[tid].stmt_err_info.push_back("");
         if (debug_mode)
@@ -285,12 +415,13 @@ int transaction_test::trans_test_unit(int stmt_pos, stmt_output& output, bool de
 
         if (err.find("ost connection") != string::npos || err.find("BUG") != string::npos) // lost connection
             throw e;
+        if (err.find("SERVER_HANG") != string::npos) // the statement cannot be killed
+            throw e;
         if (err.find("blocked") != string::npos)
             return 0;
         if (err.find("skipped") != string::npos) {
-            stmt_output empty_output;
-            output = empty_output;
-            trans_arr[tid].stmt_outputs.push_back(empty_output);
+            output = empty_stmt_output();
+            trans_arr[tid].stmt_outputs.push_back(output);
             trans_arr[tid].stmt_err_info.push_back("");
             return 2;
         }
@@ -304,9 +435,8 @@ int transaction_test::trans_test_unit(int stmt_pos, stmt_output& output, bool de
                             (stmt.size() <= commit_str.size() + 3) &&
                             (stmt.size() >= commit_str.size());
         if (!is_commit) { // it is not commit stmt 
-            stmt_output empty_output;
-            output = empty_output;
-            trans_arr[tid].stmt_outputs.push_back(empty_output);
+            output = empty_stmt_output();
+            trans_arr[tid].stmt_outputs.push_back(output);
             trans_arr[tid].stmt_err_info.push_back(err);
             return 1;
         }
@@ -322,9 +452,8 @@ int transaction_test::trans_test_unit(int stmt_pos, stmt_output& output, bool de
         show_str = stmt.substr(0, stmt.size() > SHOW_CHARACTERS ? SHOW_CHARACTERS : stmt.size());
         try {
             trans_arr[tid].dut->test(stmt);
-            stmt_output empty_output;
-            output = empty_output;
-            trans_arr[tid].stmt_outputs.push_back(empty_output);
+            output = empty_stmt_output();
+            trans_arr[tid].stmt_outputs.push_back(output);
             trans_arr[tid].stmt_err_info.push_back("");
             if (debug_mode)
                 cerr << "T" << tid << " S" << trans_arr[tid].stmt_outputs.size() - 1  << ": " << show_str << endl;
@@ -359,22 +488,17 @@ void transaction_test::retry_block_stmt(int cur_stmt_num, int* status_queue, boo
             continue;
         
         first_tried_tid.insert(tid);
-        stmt_output output;
+        stmt_output_ref output;
         auto is_executed = trans_test_unit(i, output, debug_mode);
         if (is_executed == 1) { // executed
             trans_arr[tid].is_blocked = false;
             status_queue[i] = 1;
-            real_tid_queue.push_back(tid);
-            real_stmt_queue.push_back(stmt_queue[i]);
-            real_output_queue.push_back(output);
-            real_stmt_usage.push_back(stmt_use[i]);
+            record_real_stmt(tid, stmt_queue[i], output, stmt_use[i]);
         } else if (is_executed == 2) { // skipped
             trans_arr[tid].is_blocked = false;
             
-            real_tid_queue.push_back(tid);
-            real_stmt_queue.push_back(make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT));
-            real_output_queue.push_back(output);
-            real_stmt_usage.push_back(stmt_usage(INIT_TYPE, su.is_instrumented));
+            record_real_stmt(tid, make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT), 
+                                output, stmt_usage(INIT_TYPE, su.is_instrumented));
             status_queue[i] = 1;
         } else {// blocked
             trans_arr[tid].is_blocked = true;
@@ -392,16 +516,13 @@ void transaction_test::retry_block_stmt(int cur_stmt_num, int* status_queue, boo
         if (status_queue[stmt_pos] == 1)
             continue;
 
-        stmt_output output;
+        stmt_output_ref output;
         auto is_executed = trans_test_unit(stmt_pos, output, debug_mode);
         // successfully execute the stmt, so label as not blocked
         if (is_executed == 1) {
             trans_arr[tid].is_blocked = false;
             status_queue[stmt_pos] = 1;
-            real_tid_queue.push_back(tid);
-            real_stmt_queue.push_back(stmt_queue[stmt_pos]);
-            real_output_queue.push_back(output);
-            real_stmt_usage.push_back(stmt_use[stmt_pos]);
+            record_real_stmt(tid, stmt_queue[stmt_pos], output, stmt_use[stmt_pos]);
             
             auto stmt = print_stmt_to_string(stmt_queue[stmt_pos]);
             auto commit_str = trans_arr[tid].dut->commit_stmt();
@@ -419,10 +540,8 @@ void transaction_test::retry_block_stmt(int cur_stmt_num, int* status_queue, boo
             trans_arr[tid].is_blocked = false;
             status_queue[stmt_pos] = 1;
 
-            real_tid_queue.push_back(tid);
-            real_stmt_queue.push_back(make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT));
-            real_output_queue.push_back(output);
-            real_stmt_usage.push_back(stmt_usage(INIT_TYPE, su.is_instrumented));
+            record_real_stmt(tid, make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT), 
+                                output, stmt_usage(INIT_TYPE, su.is_instrumented));
         }
         else { // still blocked
             trans_arr[tid].is_blocked = true;
@@ -432,10 +551,35 @@ void transaction_test::retry_block_stmt(int cur_stmt_num, int* status_queue, boo
         cerr << YELLOW << "retrying process end..." << RESET << endl;
 }
 
-void transaction_test::trans_test(bool debug_mode)
+// append the executed stmt to the real queues, and feed it to the streaming
+// analyzer so that trans_test can stop once a violation is certain
+void transaction_test::record_real_stmt(int tid, shared_ptr<prod> stmt, stmt_output_ref& output, stmt_usage su)
+{
+    real_tid_queue.push_back(tid);
+    real_stmt_queue.push_back(stmt);
+    real_output_queue.push_back(output);
+    real_stmt_usage.push_back(su);
+
+    if (stream_da == NULL)
+        return;
+    stream_da->consume_stmt(tid, su, *output);
+    // the commit or abort stmt is the last one of the txn
+    if (trans_arr[tid].stmt_outputs.size() == trans_arr[tid].stmts.size())
+        stream_da->finish_txn(tid, trans_arr[tid].status);
+}
+
+void transaction_test::trans_test(bool debug_mode, bool stream_check)
 {
     dut_reset_to_backup(test_dbms_info);
     dut_get_content(test_dbms_info, init_db_content); // get initial database content
+
+    stream_da = NULL;
+    if (stream_check) {
+        vector<stmt_output> init_content_vector;
+        for (auto iter = init_db_content.begin(); iter != init_db_content.end(); iter++)
+            init_content_vector.push_back(iter->second);
+        stream_da = make_shared<stream_analyzer>(init_content_vector, trans_num, 1, 0);
+    }
     
     if (debug_mode)
         cerr << YELLOW << "transaction test" << RESET << endl;
@@ -461,7 +605,7 @@ void transaction_test::trans_test(bool debug_mode)
         if (trans_arr[tid].is_blocked)
             continue;
         
-        stmt_output output;
+        stmt_output_ref output;
         auto is_executed = trans_test_unit(stmt_index, output, debug_mode);
         if (is_executed == 0) {
             trans_arr[tid].is_blocked = true;
@@ -469,17 +613,12 @@ void transaction_test::trans_test(bool debug_mode)
         }
         if (is_executed == 2) { // the executed stmt fail
             status_queue[stmt_index] = 1;
-            real_tid_queue.push_back(tid);
-            real_stmt_queue.push_back(make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT));
-            real_output_queue.push_back(output);
-            real_stmt_usage.push_back(stmt_usage(INIT_TYPE, su.is_instrumented));
+            record_real_stmt(tid, make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT), 
+                                output, stmt_usage(INIT_TYPE, su.is_instrumented));
             continue;
         }
         status_queue[stmt_index] = 1;
-        real_tid_queue.push_back(tid);
-        real_stmt_queue.push_back(stmt);
-        real_output_queue.push_back(output);
-        real_stmt_usage.push_back(su);
+        record_real_stmt(tid, stmt, output, su);
         
         // after a commit or abort, retry the statement
         auto stmt_str = print_stmt_to_string(stmt);
@@ -615,11 +754,17 @@ void transaction_test::save_test_case(string dir_name,
     }
     stmt_use_output.close();
 
+    // the level of a bug found by multi_level_test(), for --reproduce-isolation
+    if (!test_dbms_info.session_level_name.empty())
+        save_session_level(dir_name + prefix + "_isolation.txt", test_dbms_info);
+
     cerr << RED << "done" << RESET << endl;
 }
 
 int transaction_test::record_bug_num = 0;
 pid_t transaction_test::server_process_id = 0xabcde;
+string transaction_test::trace_dir;
+string transaction_test::schedule_filter_file = SCHEDULE_FILTER_FILE;
 
 static unsigned long long get_cur_time_ms(void) {
 	struct timeval tv;
@@ -630,6 +775,30 @@ static unsigned long long get_cur_time_ms(void) {
 	return (tv.tv_sec * 1000ULL) + tv.tv_usec / 1000;
 }
 
+// the tests run in forked processes, so the file is named by pid and time
+void transaction_test::record_trace(vector<stmt_output>& init_output, vector<txn_status>& real_txn_status)
+{
+    static int trace_count = 0;
+    txn_trace trace;
+    trace.isolation = test_dbms_info.isolation;
+    trace.t_num = trans_num;
+    trace.txn_status_queue = real_txn_status;
+    trace.init_output = init_output;
+    for (auto& stmt : real_stmt_queue)
+        trace.stmts.push_back(print_stmt_to_string(stmt));
+    trace.tid_queue = real_tid_queue;
+    trace.usage_queue = real_stmt_usage;
+    trace.output_queue = real_output_queue;
+
+    auto path = trace_dir + "/trace_" + to_string(getpid()) + "_" + 
+                to_string(get_cur_time_ms()) + "_" + to_string(trace_count++) + ".txt";
+    try {
+        save_trace(path, trace);
+    } catch (exception& e) {
+        cerr << "record_trace: " << e.what() << endl;
+    }
+}
+
 void kill_process_with_SIGTERM(pid_t process_id)
 {
     kill(process_id, SIGTERM);
@@ -689,6 +858,13 @@ bool transaction_test::try_to_kill_server()
     return flag;
 }
 
+// cannot be called by child process
+void transaction_test::restart_server(dbms_info& d_info)
+{
+    while (try_to_kill_server() == false) {}
+    server_process_id = fork_db_server(d_info);
+}
+
 bool transaction_test::fork_if_server_closed(dbms_info& d_info)
 {
     bool server_restart = false;
@@ -696,6 +872,10 @@ bool transaction_test::fork_if_server_closed(dbms_info& d_info)
 
     while (1) {
         try {
+            // a server accepting connections may still hang on queries, so it
+            // is asked with a read timeout before setting up the session
+            if (!is_server_alive(d_info))
+                throw runtime_error("the server does not answer");
             auto dut = dut_setup(d_info);
             if (server_restart)
                 sleep(3);
@@ -705,9 +885,7 @@ bool transaction_test::fork_if_server_closed(dbms_info& d_info)
             auto ret = kill(server_process_id, 0);
             if (ret != 0) { // server has die
                 cerr << "testing server die, restart it" << endl;
-
-                while (try_to_kill_server() == false) {} // just for safe
-                server_process_id = fork_db_server(d_info);
+                restart_server(d_info);
                 time_begin = get_cur_time_ms();
                 server_restart = true;
                 continue;
@@ -716,9 +894,7 @@ bool transaction_test::fork_if_server_closed(dbms_info& d_info)
             auto time_end = get_cur_time_ms();
             if (time_end - time_begin > WAIT_FOR_PROC_TIME_MS) {
                 cerr << "testing server hang, kill it and restart" << endl;
-                
-                while (try_to_kill_server() == false) {}
-                server_process_id = fork_db_server(d_info);
+                restart_server(d_info);
                 time_begin = get_cur_time_ms();
                 server_restart = true;
                 continue;
@@ -797,9 +973,6 @@ bool transaction_test::refine_stmt_queue(vector<stmt_id>& stmt_path, shared_ptr<
             // change its instrumented stmt as SPACE_HOLDER_STMT
             stmt_use[one_stmt_idx].is_instrumented = false; 
             stmt_queue[one_stmt_idx] = make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT);
-
-            // auto chosen_stmt_id = stmt_id(tid_queue, one_stmt_idx);
-            // cerr << "(" << chosen_stmt_id.txn_id << "." << chosen_stmt_id.stmt_idx_in_txn << ") ";
         }
     }
     // cerr << endl;
@@ -812,41 +985,201 @@ bool transaction_test::refine_stmt_queue(vector<stmt_id>& stmt_path, shared_ptr<
     return true;
 }
 
+static string normal_savepoint(int prefix_len)
+{
+    return NORMAL_SAVEPOINT_PREFIX + to_string(prefix_len);
+}
+
+// the savepoints need the path in one transaction instead of autocommit. for the path of a 
+// single session it is the same if no stmt commits implicitly (DDL) and no constraint is 
+// deferred to the commit, which holds for the DML stmts on mysql and mariadb. tidb checks 
+// the unique keys of optimistic (and of some pessimistic) transactions at the commit
+static bool can_replay_in_txn(string& dbms_name, vector<string>& stmts)
+{
+    if (dbms_name != "mysql" && dbms_name != "mariadb")
+        return false;
+    for (auto& stmt : stmts) {
+        auto begin = stmt.find_first_not_of(" \t\n(");
+        if (begin == string::npos)
+            continue;
+        auto end = stmt.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ", begin);
+        auto word = stmt.substr(begin, end == string::npos ? string::npos : end - begin);
+        transform(word.begin(), word.end(), word.begin(), ::tolower);
+        if (word != "select" && word != "with" && word != "insert" && 
+                word != "update" && word != "delete" && word != "replace")
+            return false;
+    }
+    return true;
+}
+
+bool transaction_test::open_normal_session()
+{
+    normal_dut.reset(); // close the old one first, otherwise dropping the database waits for its locks
+    normal_prefix_stmts.clear();
+    normal_prefix_output.clear();
+    normal_prefix_err_info.clear();
+
+    normal_dbms_info = test_dbms_info;
+    normal_dbms_info.test_db = test_dbms_info.test_db + NORMAL_DB_SUFFIX;
+    dut_reset_to_backup(normal_dbms_info);
+    // the replayed stmts are DML, so the tables are the ones in the backup
+    normal_table_names.clear();
+    auto normal_schema = get_schema(normal_dbms_info);
+    for (auto& table:normal_schema->tables)
+        normal_table_names.push_back(table.ident());
+    normal_dut = dut_setup(normal_dbms_info);
+    try {
+        normal_dut->test(normal_dut->begin_stmt() + ";");
+        normal_dut->test("SAVEPOINT " + normal_savepoint(0) + ";");
+    } catch (exception &e) {
+        string err = e.what();
+        normal_dut.reset();
+        if (err.find("SERVER_HANG") != string::npos) // not refused, the caller restarts the server
+            throw;
+        cerr << "cannot open the savepoint session, replay in autocommit: " << err << endl;
+        return false;
+    }
+    return true;
+}
+
+void transaction_test::close_normal_session()
+{
+    if (normal_dbms_info.test_db.empty()) // not opened
+        return;
+    normal_dut.reset();
+    try {
+        auto dut = dut_setup(test_dbms_info);
+        dut->test("drop database if exists " + normal_dbms_info.test_db + ";");
+    } catch (exception &e) {
+        cerr << "cannot drop " << normal_dbms_info.test_db << ": " << e.what() << endl;
+    }
+    normal_dbms_info.test_db = "";
+}
+
+bool transaction_test::replay_normal_path(vector<string>& stmts, 
+                                            vector<stmt_output>& outputs, 
+                                            vector<string>& errs,
+                                            bool& savepoint_lost)
+{
+    int path_length = stmts.size();
+    // roll back to the longest prefix shared with the last replayed path
+    // (later savepoints are released by the rollback)
+    int shared_len = 0;
+    if (normal_dut != NULL) {
+        while (shared_len < path_length && shared_len < normal_prefix_stmts.size() &&
+                stmts[shared_len] == normal_prefix_stmts[shared_len])
+            shared_len++;
+        try {
+            if (shared_len < normal_prefix_stmts.size())
+                normal_dut->test("ROLLBACK TO SAVEPOINT " + normal_savepoint(shared_len) + ";");
+            normal_prefix_stmts.resize(shared_len);
+            normal_prefix_output.resize(shared_len);
+            normal_prefix_err_info.resize(shared_len);
+        } catch (exception &e) {
+            cerr << "cannot roll back to the savepoint, restart the normal session: " << e.what() << endl;
+            normal_dut.reset();
+        }
+    }
+    if (normal_dut == NULL) {
+        if (!open_normal_session())
+            return false;
+        shared_len = 0;
+    }
+    cerr << "(reuse " << shared_len << " stmts) ";
+
+    // the rest of the path is known up front, so send it in one batch
+    vector<string> batch;
+    for (int i = shared_len; i < path_length; i++) {
+        batch.push_back(stmts[i]);
+        batch.push_back("SAVEPOINT " + normal_savepoint(i + 1) + ";");
+    }
+    vector<stmt_output> batch_outputs;
+    vector<string> batch_errs;
+    try {
+        normal_dut->test_batch(batch, batch_outputs, batch_errs);
+    } catch (exception &e) {
+        normal_dut.reset();
+        throw;
+    }
+    savepoint_lost = false;
+    for (int i = shared_len; i < path_length; i++) {
+        auto batch_idx = (i - shared_len) * 2;
+        normal_prefix_stmts.push_back(stmts[i]);
+        normal_prefix_output.push_back(batch_outputs[batch_idx]);
+        normal_prefix_err_info.push_back(batch_errs[batch_idx]);
+        if (batch_errs[batch_idx + 1] != "")
+            savepoint_lost = true;
+    }
+    outputs = normal_prefix_output;
+    errs = normal_prefix_err_info;
+    return true;
+}
+
 void transaction_test::normal_stmt_test(vector<stmt_id>& stmt_path)
 {
     cerr << "normal testing ... ";
-    dut_reset_to_backup(test_dbms_info);
-    auto normal_dut = dut_setup(test_dbms_info);
-    int count = -1;
+    vector<string> stmts;
     for (auto& stmt_id : stmt_path) {
-        count++;
         auto tid = stmt_id.txn_id;
         auto stmt_pos = stmt_id.stmt_idx_in_txn;
-        auto stmt = print_stmt_to_string(trans_arr[tid].stmts[stmt_pos]);
+        stmts.push_back(print_stmt_to_string(trans_arr[tid].stmts[stmt_pos]));
+    }
+    auto path_length = stmt_path.size();
+
+    vector<stmt_output> outputs;
+    vector<string> errs;
+    bool in_txn = !normal_session_refused && can_replay_in_txn(test_dbms_info.dbms_name, stmts);
+    bool savepoint_lost = false;
+    if (in_txn && !replay_normal_path(stmts, outputs, errs, savepoint_lost)) {
+        normal_session_refused = true;
+        in_txn = false;
+    }
+    if (!in_txn) {
+        cerr << "(autocommit) ";
+        dut_reset_to_backup(test_dbms_info);
+        auto autocommit_dut = dut_setup(test_dbms_info);
+        autocommit_dut->test_batch(stmts, outputs, errs);
+    }
+
+    for (int count = 0; count < path_length; count++) {
+        auto& err = errs[count];
+        if (err == "") {
+            normal_stmt_output.push_back(outputs[count]);
+            normal_stmt_err_info.push_back("");
+            continue;
+        }
+        
+        auto& stmt = stmts[count];
         auto show_str = stmt.substr(0, stmt.size() > SHOW_CHARACTERS ? SHOW_CHARACTERS : stmt.size());
         replace(show_str.begin(), show_str.end(), '\n', ' ');
-        stmt_output output;
-        try {
-            normal_dut->test(stmt, &output);
-            normal_stmt_output.push_back(output);
-            normal_stmt_err_info.push_back("");
-            // cerr << count << " T" << tid << " S" << stmt_pos << ": " << show_str << endl;
-        } catch (exception &e) {
-            string err = e.what();
-            stmt_output empty_output;
-            cerr << RED << count
-                << " T" << tid << " S" << stmt_pos << ": " << show_str << ": fail, err: " 
-                << err << RESET << endl;
-            if (err.find("skipped") != string::npos) {
-                normal_stmt_output.push_back(empty_output);
-                normal_stmt_err_info.push_back("");
-                continue;
-            }
+        stmt_output empty_output;
+        cerr << RED << count
+            << " T" << stmt_path[count].txn_id << " S" << stmt_path[count].stmt_idx_in_txn << ": " << show_str << ": fail, err: " 
+            << err << RESET << endl;
+        if (err.find("SERVER_HANG") != string::npos) { // not a result of the statements
+            normal_dut.reset();
+            throw runtime_error(err);
+        }
+        if (err.find("skipped") != string::npos) {
             normal_stmt_output.push_back(empty_output);
-            normal_stmt_err_info.push_back(err);
+            normal_stmt_err_info.push_back("");
+            continue;
         }
+        normal_stmt_output.push_back(empty_output);
+        normal_stmt_err_info.push_back(err);
+    }
+
+    if (!in_txn) {
+        dut_get_content(test_dbms_info, normal_stmt_db_content);
+        cerr << "done" << endl;
+        return;
+    }
+    // the changes are not committed, so read them in the same session
+    normal_dut->get_content(normal_table_names, normal_stmt_db_content);
+    if (savepoint_lost) {
+        cerr << "savepoint fails, the next path starts from the backup again ";
+        normal_dut.reset();
     }
-    dut_get_content(test_dbms_info, normal_stmt_db_content);
     cerr << "done" << endl;
 }
 
@@ -878,7 +1211,7 @@ bool transaction_test::check_normal_stmt_result(vector<stmt_id>& stmt_path, bool
     for (int i = 0; i < path_length; i++) {
         auto tid = stmt_path[i].txn_id;
         auto stmt_pos = stmt_path[i].stmt_idx_in_txn;
-        path_txn_output.push_back(trans_arr[tid].stmt_outputs[stmt_pos]);
+        path_txn_output.push_back(*trans_arr[tid].stmt_outputs[stmt_pos]); // compare_output normalizes it in place
         path_txn_err_info.push_back(trans_arr[tid].stmt_err_info[stmt_pos]);
     }
 
@@ -921,7 +1254,7 @@ bool transaction_test::check_normal_stmt_result(vector<stmt_id>& stmt_path, bool
     return true;
 }
 
-void print_stmt_path(vector<stmt_id>& stmt_path, map<pair<stmt_id, stmt_id>, set<dependency_type>>& stmt_graph)
+void print_stmt_path(vector<stmt_id>& stmt_path, dependency_analyzer& da)
 {
     auto path_length = stmt_path.size();
     for (int i = 0; i < path_length; i++) {
@@ -931,32 +1264,33 @@ void print_stmt_path(vector<stmt_id>& stmt_path, map<pair<stmt_id, stmt_id>, set
         for (forward_steps = 1; i + forward_steps < path_length; forward_steps++) {
             auto j = i + forward_steps;
             auto& stmt_j = stmt_path[j];
-            auto branch = make_pair<>(stmt_i, stmt_j);
-            if (stmt_graph.count(branch) == 0)
+            auto idx_i = da.get_queue_idx(stmt_i);
+            auto idx_j = da.get_queue_idx(stmt_j);
+            if (idx_i == -1 || idx_j == -1)
                 continue;
-            auto& dset = stmt_graph[branch];
+            auto dset = da.get_stmt_depend(idx_i, idx_j);
             bool printed = false;
-            if (dset.count(WRITE_READ)) {
+            if (dset & DEPEND_BIT(WRITE_READ)) {
                 cerr << RED << forward_steps << "WR|" << RESET;
                 printed = true;
             }
-            if (dset.count(WRITE_WRITE)) {
+            if (dset & DEPEND_BIT(WRITE_WRITE)) {
                 cerr << RED << forward_steps << "WW|" << RESET;
                 printed = true;
             }
-            if (dset.count(READ_WRITE)) {
+            if (dset & DEPEND_BIT(READ_WRITE)) {
                 cerr << RED << forward_steps << "RW|" << RESET;
                 printed = true;
             }
-            if (dset.count(VERSION_SET_DEPEND)) {
+            if (dset & DEPEND_BIT(VERSION_SET_DEPEND)) {
                 cerr << RED << forward_steps << "VS|" << RESET;
                 printed = true;
             }
-            if (dset.count(OVERWRITE_DEPEND)) {
+            if (dset & DEPEND_BIT(OVERWRITE_DEPEND)) {
                 cerr << RED << forward_steps << "OW|" << RESET;
                 printed = true;
             }
-            if (dset.count(INSTRUMENT_DEPEND)) {
+            if (dset & DEPEND_BIT(INSTRUMENT_DEPEND)) {
                 cerr << forward_steps << "IN|";
                 printed = true;
             }
@@ -1027,8 +1361,8 @@ void infer_instrument_after_blocking(vector<shared_ptr<prod>>& whole_before_stmt
         }
 
         // they are different, mean that this stmt has been changed to space_holder after blocking scheduling
-        auto instrumented_set = before_da->get_instrumented_stmt_set(j);
-        auto set_size = instrumented_set.size();
+        auto group = before_da->instrument_group_of[j];
+        auto set_size = before_da->group_end(group) - before_da->group_begin(group);
         for (int k = 0; k < set_size; k++) { // put it set_size times to make the queue size same
             final_after_stmt_queue.push_back(after_stmt_queue[i]);
             final_after_tid_queue.push_back(tid);
@@ -1062,7 +1396,11 @@ bool transaction_test::multi_stmt_round_test()
     original_stmt_use = stmt_use;
     original_tid_queue = tid_queue;
 
-    trans_test(false); // first run, get all dependency information
+    // the same schedule at each level of --isolation-levels, then the default one is tested as usual
+    if (!test_dbms_info.oracle_levels.empty() && multi_level_test())
+        throw runtime_error("BUG: found in multi_level_test()");
+
+    trans_test(false, true); // first run, get all dependency information
     shared_ptr<dependency_analyzer> init_da;
     if (analyze_txn_dependency(init_da)) 
         throw runtime_error("BUG: found in analyze_txn_dependency()");
@@ -1079,15 +1417,16 @@ bool transaction_test::multi_stmt_round_test()
     }
     set<stmt_id> deleted_nodes;
     set<stmt_id> all_nodes;
-    for (int i = 0; i < stmt_num; i++) {
-        auto tid = tid_queue[i];
-        if (init_txn_status[tid] != TXN_COMMIT)
+    for (int i = 0; i < init_da->stmt_num; i++) {
+        auto sid = init_da->get_stmt_id(i);
+        if (init_txn_status[sid.txn_id] != TXN_COMMIT)
             continue;
-        all_nodes.insert(stmt_id(tid_queue, i));
+        all_nodes.insert(sid);
     }
 
     int round_count = 1;
     int stmt_path_empty_time = 0;
+    shared_ptr<dependency_analyzer> round_da; // reset by each refinement, init_da is kept
     while (1) { // until there is not statement in the stmt path
         auto longest_stmt_path = init_da->topological_sort_path(deleted_nodes);
         if (longest_stmt_path.empty()) {
@@ -1110,7 +1449,7 @@ bool transaction_test::multi_stmt_round_test()
         // }
         // cerr << endl;
         // cerr << "ideal test stmt path: ";
-        // print_stmt_path(longest_stmt_path, init_da->stmt_dependency_graph);
+        // print_stmt_path(longest_stmt_path, *init_da);
 
         // use the longest path to refine
         bool empty_stmt_path = false;
@@ -1140,13 +1479,14 @@ bool transaction_test::multi_stmt_round_test()
             // cerr << YELLOW << "final instrmented stmt_queue length: " << stmt_queue.size() << RESET << endl;
 
             // cerr << RED << "txn testing:" << RESET << endl;
-            trans_test(false);
-            if (analyze_txn_dependency(tmp_da)) 
+            trans_test(false, true);
+            if (analyze_txn_dependency(round_da)) 
                 throw runtime_error("BUG: found in analyze_txn_dependency()");
+            tmp_da = round_da;
             longest_stmt_path = tmp_da->topological_sort_path(deleted_nodes);
 
             // cerr << RED << "stmt path for refining: " << RESET;
-            // print_stmt_path(longest_stmt_path, tmp_da->stmt_dependency_graph);
+            // print_stmt_path(longest_stmt_path, *tmp_da);
             if (longest_stmt_path.empty()) {
                 empty_stmt_path = true;
                 break;
@@ -1168,35 +1508,15 @@ bool transaction_test::multi_stmt_round_test()
         
         // delete stmts from the stmt_dependency_graph
         auto path_length = longest_stmt_path.size();
-        auto& stmt_graph = init_da->stmt_dependency_graph;
-        auto& init_da_tid_queue = init_da->f_txn_id_queue;
         // cerr << "deleting node: ";
         for (int i = 0; i < path_length; i++) {
             auto& cur_sid = longest_stmt_path[i];
             // cerr << "(" << cur_sid.txn_id << "." << cur_sid.stmt_idx_in_txn << ") ";
-            auto queue_idx = cur_sid.transfer_2_stmt_idx(init_da_tid_queue);
-            auto idx_set = init_da->get_instrumented_stmt_set(queue_idx);
-            for (auto& delete_idx : idx_set) {
-                auto chosen_stmt_id = stmt_id(init_da_tid_queue, delete_idx);
+            auto group = init_da->instrument_group_of[init_da->get_queue_idx(cur_sid)];
+            for (auto delete_it = init_da->group_begin(group); delete_it != init_da->group_end(group); delete_it++) {
+                auto chosen_stmt_id = init_da->get_stmt_id(*delete_it);
                 deleted_nodes.insert(chosen_stmt_id);
-                for (int j = 0; j < init_da->stmt_num; j++) {
-                    auto another_stmt = stmt_id(init_da_tid_queue, j);
-                    auto out_branch = make_pair(chosen_stmt_id, another_stmt);
-                    auto in_branch = make_pair(another_stmt, chosen_stmt_id);
-                    // should not delete INSTRUMENT_DEPEND edge which is needed for get_instrument_set
-                    if (stmt_graph[in_branch].count(INSTRUMENT_DEPEND) > 0) {
-                        stmt_graph[in_branch].clear();
-                        stmt_graph[in_branch].insert(INSTRUMENT_DEPEND);
-                    }
-                    else
-                        stmt_graph.erase(in_branch);
-                    if (stmt_graph[out_branch].count(INSTRUMENT_DEPEND) > 0) {
-                        stmt_graph[out_branch].clear();
-                        stmt_graph[out_branch].insert(INSTRUMENT_DEPEND);
-                    }
-                    else
-                        stmt_graph.erase(out_branch);
-                }
+                init_da->delete_stmt(*delete_it);
             }
         }
         // cerr << endl;
@@ -1259,13 +1579,26 @@ int transaction_test::test()
         save_backup_file(dir_name, test_dbms_info); // save database
         return 1; // not need to do other transaction thing
     }
+
+    if (!schedule_filter_file.empty()) {
+        schedule_filter filter(schedule_filter_file);
+        if (filter.test_and_insert(schedule_fingerprint())) {
+            cerr << "the schedule has been tested, skip it" << endl;
+            return 0;
+        }
+    }
     
     try {
-        if (multi_stmt_round_test() == false)
+        auto found_bug = multi_stmt_round_test();
+        close_normal_session();
+        if (found_bug == false)
             return 0;
     } catch(exception &e) {
         string err = e.what();
         cerr << "error captured by test: " << err << endl;
+        if (err.find("SERVER_HANG") != string::npos) // the caller restarts the server
+            return SERVER_HANG_RET;
+        close_normal_session();
         if (err.find("INSTRUMENT_ERR") != string::npos) // it is cause by: after instrumented, the scheduling change and error in txn_test happens
             return 0;
         if (err.find("still not executed") != string::npos) // cannot reproduce
@@ -1297,6 +1630,7 @@ transaction_test::transaction_test(dbms_info& d_info)
         stmt_num += trans_arr[i].stmt_num;
     }
 
+    normal_session_refused = false;
     output_path_dir = "found_bugs/";
     struct stat buffer;
     if (stat(output_path_dir.c_str(), &buffer) != 0) {
@@ -1306,5 +1640,6 @@ transaction_test::transaction_test(dbms_info& d_info)
 
 transaction_test::~transaction_test()
 {
+    close_normal_session();
     delete[] trans_arr;
 }
@@ -7,6 +7,8 @@
 #include "general_process.hh"
 #include "instrumentor.hh"
 #include "dependency_analyzer.hh"
+#include "schedule_filter.hh"
+#include "trace.hh"
 
 #include <sys/time.h>
 #include <sys/wait.h>
@@ -15,13 +17,16 @@ using namespace std;
 
 #define SHOW_CHARACTERS 100
 #define SPACE_HOLDER_STMT "select 1 from (select 1) as subq_0 where 0 <> 0"
+#define NORMAL_DB_SUFFIX "_normal" // shadow database of the serial replay
+#define NORMAL_SAVEPOINT_PREFIX "normal_sp"
+#define SERVER_HANG_RET 2 // test(): a statement cannot be killed, the server should be restarted
 
 struct transaction {
     shared_ptr<dut_base> dut;
     bool is_blocked;
     
     vector<shared_ptr<prod>> stmts;
-    vector<stmt_output> stmt_outputs;
+    vector<stmt_output_ref> stmt_outputs;
     vector<string> stmt_err_info;
 
     vector<shared_ptr<prod>> normal_stmts;
@@ -39,6 +44,9 @@ public:
     static int record_bug_num;
     static pid_t server_process_id;
     static bool try_to_kill_server();
+    static void restart_server(dbms_info& d_info);
+    static string trace_dir; // not empty: every analyzed execution is saved there (for txcheck-analyze)
+    static string schedule_filter_file; // empty: the tested schedules are not filtered
 
     transaction* trans_arr;
     string output_path_dir;
@@ -58,7 +66,7 @@ public:
 
     vector<int> real_tid_queue;
     vector<shared_ptr<prod>> real_stmt_queue;
-    vector<stmt_output> real_output_queue;
+    vector<stmt_output_ref> real_output_queue;
     vector<stmt_usage> real_stmt_usage;
     map<string, vector<vector<string>>> trans_db_content;
 
@@ -67,6 +75,24 @@ public:
     vector<string> normal_stmt_err_info;
     map<string, vector<vector<string>>> normal_stmt_db_content;
 
+    // the serial replay of a DML path keeps one transaction open on a shadow database 
+    // and sets savepoint <i> after the i-th statement of the last replayed path, so a 
+    // path sharing a prefix with it only executes the rest. other paths are replayed 
+    // in autocommit on the test database
+    dbms_info normal_dbms_info;
+    shared_ptr<dut_base> normal_dut;
+    vector<string> normal_table_names;
+    vector<string> normal_prefix_stmts;
+    vector<stmt_output> normal_prefix_output;
+    vector<string> normal_prefix_err_info;
+    bool normal_session_refused; // the dbms refused the transaction or the savepoint, use autocommit
+    // false: the dbms refuses the transaction or the first savepoint
+    bool open_normal_session();
+    // drop the shadow database, it never throws
+    void close_normal_session();
+    // false: the shadow session cannot be opened, the path is not replayed
+    bool replay_normal_path(vector<string>& stmts, vector<stmt_output>& outputs, vector<string>& errs, bool& savepoint_lost);
+
     //original stmt test case
     vector<int> original_tid_queue;
     vector<shared_ptr<prod>> original_stmt_queue;
@@ -78,18 +104,28 @@ public:
     void instrument_txn_stmts();
     void clean_instrument();
     void block_scheduling();
+    string schedule_fingerprint();
 
     bool change_txn_status(int tid, txn_status final_status);
-    bool analyze_txn_dependency(shared_ptr<dependency_analyzer>& da); // input da is empty; output the analyzed da
+    bool analyze_txn_dependency(shared_ptr<dependency_analyzer>& da); // input da is empty or reset in place; output the analyzed da
+    void get_execution_input(vector<stmt_output>& init_output, vector<txn_status>& real_txn_status);
+    // execute the schedule at each level of test_dbms_info.oracle_levels and check the guarantee
+    // of the level. the executions observing the same history share one analyzer (its graphs are 
+    // built once). true: violated (test_dbms_info keeps the level); false: the state is restored
+    bool multi_level_test();
+    void record_trace(vector<stmt_output>& init_output, vector<txn_status>& real_txn_status);
     void clear_execution_status();
     bool multi_stmt_round_test(); // true: find bugs; false: no bug
     bool refine_stmt_queue(vector<stmt_id>& stmt_path, shared_ptr<dependency_analyzer>& da);
     void normal_stmt_test(vector<stmt_id>& stmt_path);
     bool check_normal_stmt_result(vector<stmt_id>& stmt_path, bool debug = false);
     
-    void trans_test(bool debug_mode = true);
+    // stream_check: check G1a/G1b/G1c while executing, and throw once a violation is certain
+    void trans_test(bool debug_mode = true, bool stream_check = false);
+    shared_ptr<stream_analyzer> stream_da;
+    void record_real_stmt(int tid, shared_ptr<prod> stmt, stmt_output_ref& output, stmt_usage su);
     void retry_block_stmt(int cur_stmt_num, int* status_queue, bool debug_mode = true);
-    int trans_test_unit(int stmt_pos, stmt_output& output, bool debug_mode = true);
+    int trans_test_unit(int stmt_pos, stmt_output_ref& output, bool debug_mode = true);
 
     static bool fork_if_server_closed(dbms_info& d_info);
 
@@ -106,6 +142,6 @@ private:
                         vector<stmt_usage>& tar_usage_queue);
 };
 
-void print_stmt_path(vector<stmt_id>& stmt_path, map<pair<stmt_id, stmt_id>, set<dependency_type>>& stmt_graph);
+void print_stmt_path(vector<stmt_id>& stmt_path, dependency_analyzer& da);
 
 #endif
\ No newline at end of file
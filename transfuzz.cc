@@ -43,6 +43,7 @@ extern "C" {
 
 #define NORMAL_EXIT 0
 #define FIND_BUG_EXIT 7
+#define SERVER_HANG_EXIT 8
 #define MAX_TIMEOUT_TIME 3
 #define MAX_SETUP_TRY_TIME 3
 
@@ -65,8 +66,9 @@ void kill_process_signal(int signal)
         printf("child pid timeout, kill it\n"); 
         child_timed_out = true;
 		kill(child_pid, SIGKILL);
-        // also kill server process to restart
-        while (transaction_test::try_to_kill_server() == false) {}
+        // the server is not killed here, long statements are already killed
+        // by the statement deadline of the dut. fork_if_server_closed()
+        // restarts it if it does not answer a query in time.
 	}
 
     cerr << "get SIGALRM, stop the process" << endl;
@@ -152,7 +154,9 @@ int fork_for_transaction_test(dbms_info& d_info)
 {
     static itimerval itimer;
 
-    transaction_test::fork_if_server_closed(d_info);
+    // after restarting, created tables might be lost
+    if (transaction_test::fork_if_server_closed(d_info))
+        throw runtime_error(string("restart server"));
     
     child_pid = fork();
     if (child_pid == 0) { // in child process
@@ -164,6 +168,8 @@ int fork_for_transaction_test(dbms_info& d_info)
                 cerr << RED << "Find a bug !!!" << RESET << endl;
                 exit(FIND_BUG_EXIT);
             }
+            if (ret == SERVER_HANG_RET)
+                exit(SERVER_HANG_EXIT);
         } catch(std::exception &e) { // ignore runtime error
             cerr << "in test: " << e.what() << endl;
         }
@@ -196,6 +202,11 @@ int fork_for_transaction_test(dbms_info& d_info)
             transaction_test::record_bug_num++;
             // abort();
         }
+        if (exit_code == SERVER_HANG_EXIT) {
+            cerr << "testing server hangs on a statement, kill it and restart" << endl;
+            transaction_test::restart_server(d_info);
+            throw runtime_error(string("restart server")); // created tables are lost
+        }
         if (exit_code == 255)
             abort();
     }
@@ -286,8 +297,9 @@ int main(int argc, char *argv[])
 tidb-db|tidb-port|\
 mysql-db|mysql-port|\
 mariadb-db|mariadb-port|\
-output-or-affect-num|\
-reproduce-sql|reproduce-tid|reproduce-usage|reproduce-backup)(?:=((?:.|\n)*))?");
+output-or-affect-num|record-trace|isolation-levels|\
+schedule-filter|no-schedule-filter|\
+reproduce-sql|reproduce-tid|reproduce-usage|reproduce-backup|reproduce-isolation)(?:=((?:.|\n)*))?");
   
     for(char **opt = argv + 1 ;opt < argv + argc; opt++) {
         smatch match;
@@ -315,10 +327,15 @@ reproduce-sql|reproduce-tid|reproduce-usage|reproduce-backup)(?:=((?:.|\n)*))?")
             "   --mysql-port=int   mysql server port number" << endl << 
             #endif
             "   --output-or-affect-num=int     generating statement that output num rows or affect num rows" << endl <<
+            "   --record-trace=dir             save every analyzed execution to dir (for txcheck-analyze)" << endl <<
+            "   --isolation-levels=RC,RR,SER   also execute and check each schedule at these session isolation levels (mysql, mariadb)" << endl <<
+            "   --schedule-filter=filename     the file of the tested schedules, which are skipped (default: " SCHEDULE_FILTER_FILE ")" << endl <<
+            "   --no-schedule-filter           test every generated schedule, even if it has been tested" << endl <<
             "   --reproduce-sql=filename       sql file to reproduce the problem" << endl <<
             "   --reproduce-tid=filename       tid file to reproduce the problem" << endl <<
             "   --reproduce-usage=filename     stmt usage file to reproduce the problem" << endl <<
             "   --reproduce-backup=filename     backup file to reproduce the problem" << endl << 
+            "   --reproduce-isolation=filename  session isolation level file to reproduce the problem (if the bug has one)" << endl << 
             "    --min      minimize the reproduce test case" << endl <<
             "    --help     print available command line options and exit" << endl;
         return 0;
@@ -360,8 +377,26 @@ reproduce-sql|reproduce-tid|reproduce-usage|reproduce-backup)(?:=((?:.|\n)*))?")
     cerr << "Test port: " << d_info.test_port << endl;
     cerr << "Can trigger error in transaction: " << d_info.can_trigger_error_in_txn << endl;
     cerr << "Output or affect num: " << d_info.ouput_or_affect_num << endl;
+    cerr << "Checked isolation level: " << isolation_name(d_info.isolation) << endl;
+    for (auto& level : d_info.oracle_levels)
+        cerr << "Also checked at session level: " << level.sql_name << " (" << isolation_name(level.guarantee) << ")" << endl;
     cerr << "----------------------------------" << endl;
 
+    if (options.count("record-trace")) {
+        transaction_test::trace_dir = options["record-trace"];
+        struct stat buffer;
+        if (stat(transaction_test::trace_dir.c_str(), &buffer) != 0)
+            make_dir_error_exit(transaction_test::trace_dir);
+        cerr << "Record traces to: " << transaction_test::trace_dir << endl;
+    }
+
+    if (options.count("no-schedule-filter"))
+        transaction_test::schedule_filter_file = "";
+    else if (options.count("schedule-filter"))
+        transaction_test::schedule_filter_file = options["schedule-filter"];
+    if (!transaction_test::schedule_filter_file.empty())
+        cerr << "Skip the schedules tested in: " << transaction_test::schedule_filter_file << endl;
+
     if (options.count("reproduce-sql")) {
         cerr << "enter reproduce mode" << endl;
         if (!options.count("reproduce-tid")) {
@@ -442,6 +477,12 @@ reproduce-sql|reproduce-tid|reproduce-usage|reproduce-backup)(?:=((?:.|\n)*))?")
         auto backup_file = options["reproduce-backup"];
         use_backup_file(backup_file, d_info);
 
+        // the sessions of reproduce_routine() and minimize_testcase() are set up at the level
+        if (options.count("reproduce-isolation")) {
+            use_session_level(options["reproduce-isolation"], d_info);
+            cerr << "Session isolation level: " << d_info.session_level_name << " (" << isolation_name(d_info.isolation) << ")" << endl;
+        }
+
         if (options.count("min"))
             minimize_testcase(d_info, stmt_queue, tid_queue, stmt_usage_queue);
         else {